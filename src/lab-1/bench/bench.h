@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+
+/** Returns monotonic time in seconds. */
+double bench_now(void);
+
+/** Returns a random letter or space, with about |vowelPercent|% of vowels. */
+char bench_random_char(int vowelPercent);
+
+/** Compares vowel filter implementations. */
+int bench_filter(int argc, char** argv);
+
+/** Measures the lab_1_server + lab_1_client pipeline end to end. */
+int bench_pipeline(int argc, char** argv);
+
+/** Compares fork, posix_spawn and warm pool startup latency of lab_1_client. */
+int bench_startup(int argc, char** argv);
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bootleg_stdio.h"
+#include "vowel_filter.h"
+
+/** Size of the generated text; it's filtered repeatedly to reach the total. */
+static const size_t SAMPLE_SIZE = 64 * 1024 * 1024;
+
+/** Fills |buf| with random lines, about |vowelPercent|% of vowels. */
+static void generate_text(char* buf, size_t size, int vowelPercent) {
+	for (size_t i = 0; i != size; ++i) {
+		buf[i] = rand() % 50 == 0 ? '\n' : bench_random_char(vowelPercent);
+	}
+}
+
+int bench_filter(int argc, char** argv) {
+	size_t totalMiB = argc > 0 ? strtoul(argv[0], NULL, 10) : 1024;
+	int vowelPercent = argc > 1 ? atoi(argv[1]) : 40;
+
+	char* in = (char*)malloc(SAMPLE_SIZE);
+	char* out = (char*)malloc(SAMPLE_SIZE);
+	char* expected = (char*)malloc(SAMPLE_SIZE);
+	if (!in || !out || !expected) {
+		blg_perrorf("can't allocate %zu bytes\n", SAMPLE_SIZE);
+	}
+
+	srand(123456);
+	generate_text(in, SAMPLE_SIZE, vowelPercent);
+
+	size_t expectedLength =
+	    vowel_filter_get(VOWEL_FILTER_SCALAR)(in, SAMPLE_SIZE, expected);
+
+	size_t total = totalMiB * 1024 * 1024;
+	size_t passes = (total + SAMPLE_SIZE - 1) / SAMPLE_SIZE;
+
+	for (int kind = 0; kind != VOWEL_FILTER_COUNT; ++kind) {
+		pfnVowelFilter filter = vowel_filter_get((VowelFilterKind)kind);
+		const char* name = vowel_filter_name((VowelFilterKind)kind);
+
+		if (!filter) {
+			blg_printf("filter=%s supported=0\n", name);
+			continue;
+		}
+
+		size_t length = filter(in, SAMPLE_SIZE, out);
+		bool valid = length == expectedLength && !memcmp(out, expected, length);
+
+		double start = bench_now();
+		for (size_t i = 0; i != passes; ++i) {
+			filter(in, SAMPLE_SIZE, out);
+		}
+		double elapsed = bench_now() - start;
+
+		double mib = (double)(passes * SAMPLE_SIZE) / (1024.0 * 1024.0);
+		blg_printf("filter=%s supported=1 valid=%d bytes=%zu seconds=%f mib_per_s=%f\n",
+		           name, valid, passes * SAMPLE_SIZE, elapsed, mib / elapsed);
+	}
+
+	free(in);
+	free(out);
+	free(expected);
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "bootleg_stdio.h"
+
+double bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+char bench_random_char(int vowelPercent) {
+	static const char VOWELS[] = "aeiouAEIOU";
+	static const char CONSONANTS[] = "bcdfghjklmnpqrstvwxyzBCDFGHJKLMNPQRSTVWXYZ";
+
+	if (rand() % 100 < 15) {
+		return ' ';
+	}
+	if (rand() % 100 < vowelPercent) {
+		return VOWELS[rand() % (sizeof(VOWELS) - 1)];
+	}
+	return CONSONANTS[rand() % (sizeof(CONSONANTS) - 1)];
+}
+
+int main(int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "filter") == 0) {
+		return bench_filter(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "pipeline") == 0) {
+		return bench_pipeline(argc - 1, argv + 1);
+	}
+	if (argc >= 2 && strcmp(argv[1], "startup") == 0) {
+		return bench_startup(argc - 1, argv + 1);
+	}
+
+	blg_perrorf(
+	    "usage: %s filter [MiB] [vowel %%]\n"
+	    "       %s pipeline -s <server> -c <client> [-n children] [-m MiB]\n"
+	    "                   [-l line length] [-v vowel %%] [-i file | pipe] [-M]\n"
+	    "       %s startup -c <client> [-n runs] [-r resident MiB] [-w warm-up ms]\n"
+	    "\n"
+	    "  filter   -- compares vowel filter implementations "
+	    "(default: 1024 MiB, 40%% vowels)\n"
+	    "  pipeline -- runs the server with N children on generated text "
+	    "(default: 2 children, 256 MiB, 40%% vowels, file input)\n"
+	    "  startup  -- measures time until the first filtered line with fork, "
+	    "posix_spawn and a warm pool\n"
+	    "              (default: 100 runs, 256 MiB resident, 20 ms warm-up)\n"
+	    "\n"
+	    "  Line length is `fixed:N`, `uniform:MIN:MAX` or `exp:MEAN` "
+	    "(default: uniform:0:160). -M uses merged output.\n",
+	    argv[0], argv[0], argv[0]);
+}
@@ -0,0 +1,345 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bootleg_stdio.h"
+
+/** Distribution of generated line lengths. */
+typedef struct LineLength {
+	/** 'f'ixed, 'u'niform or 'e'xponential. */
+	char kind;
+	size_t a;
+	size_t b;
+} LineLength;
+
+/** CPU time and I/O counters of a finished process and its reaped children. */
+typedef struct ProcessStats {
+	unsigned long long syscr;
+	unsigned long long syscw;
+	double user;
+	double sys;
+	double childrenUser;
+	double childrenSys;
+} ProcessStats;
+
+static bool parse_line_length(const char* spec, LineLength* length) {
+	unsigned long a = 0, b = 0;
+
+	if (sscanf(spec, "fixed:%lu", &a) == 1) {
+		*length = (LineLength){'f', a, a};
+	} else if (sscanf(spec, "uniform:%lu:%lu", &a, &b) == 2 && a <= b) {
+		*length = (LineLength){'u', a, b};
+	} else if (sscanf(spec, "exp:%lu", &a) == 1 && a > 0) {
+		*length = (LineLength){'e', a, 0};
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static size_t next_line_length(const LineLength* length) {
+	switch (length->kind) {
+		case 'u':
+			return length->a + rand() % (length->b - length->a + 1);
+		case 'e': {
+			// Geometric distribution, the discrete counterpart of exponential.
+			size_t n = 0;
+			while (rand() % (length->a + 1) != 0) ++n;
+			return n;
+		}
+		default:
+			return length->a;
+	}
+}
+
+static void write_all(int fd, const char* data, size_t length) {
+	while (length) {
+		ssize_t written = write(fd, data, length);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			blg_perrorf("can't write benchmark input: %s\n", strerror(errno));
+		}
+
+		data += written;
+		length -= written;
+	}
+}
+
+/**
+ * Writes about |size| bytes of generated lines to |fd|. Returns the amount of
+ * bytes that should be left after removing vowels.
+ */
+static size_t generate_input(int fd, size_t size, const LineLength* lineLength,
+                             int vowelPercent, size_t* nBytes, size_t* nLines) {
+	static const size_t CHUNK_SIZE = 1024 * 1024;
+
+	char* chunk = (char*)malloc(CHUNK_SIZE);
+	if (chunk == NULL) {
+		blg_perrorf("can't allocate %zu bytes\n", CHUNK_SIZE);
+	}
+
+	size_t expected = 0;
+	size_t used = 0;
+	*nBytes = 0;
+	*nLines = 0;
+
+	while (*nBytes < size) {
+		size_t length = next_line_length(lineLength);
+
+		for (size_t i = 0; i <= length; ++i) {
+			char c = i == length ? '\n' : bench_random_char(vowelPercent);
+			chunk[used++] = c;
+
+			if (!strchr("aeiouAEIOU", c)) ++expected;
+
+			if (used == CHUNK_SIZE) {
+				write_all(fd, chunk, used);
+				used = 0;
+			}
+		}
+
+		*nBytes += length + 1;
+		++*nLines;
+	}
+
+	write_all(fd, chunk, used);
+	free(chunk);
+
+	return expected;
+}
+
+/** Reads counters of the zombie process |pid| before it is reaped. */
+static void read_stats(pid_t pid, ProcessStats* stats) {
+	memset(stats, 0, sizeof(*stats));
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+
+	FILE* io = fopen(path, "r");
+	if (io) {
+		char key[32];
+		unsigned long long value;
+		while (fscanf(io, "%31[^:]: %llu\n", key, &value) == 2) {
+			if (strcmp(key, "syscr") == 0) stats->syscr = value;
+			if (strcmp(key, "syscw") == 0) stats->syscw = value;
+		}
+		fclose(io);
+	}
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+
+	FILE* stat = fopen(path, "r");
+	if (stat) {
+		// Skip pid and command, which may contain spaces.
+		char line[1024];
+		if (fgets(line, sizeof(line), stat)) {
+			char* rest = strrchr(line, ')');
+			unsigned long utime, stime;
+			long cutime, cstime;
+
+			if (rest && sscanf(rest + 2,
+			                   "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+			                   "%lu %lu %ld %ld",
+			                   &utime, &stime, &cutime, &cstime) == 4) {
+				double tick = (double)sysconf(_SC_CLK_TCK);
+				stats->user = (double)utime / tick;
+				stats->sys = (double)stime / tick;
+				stats->childrenUser = (double)cutime / tick;
+				stats->childrenSys = (double)cstime / tick;
+			}
+		}
+		fclose(stat);
+	}
+}
+
+int bench_pipeline(int argc, char** argv) {
+	const char* server = NULL;
+	const char* client = NULL;
+	int nChildren = 2;
+	size_t sizeMiB = 256;
+	LineLength lineLength = {'u', 0, 160};
+	int vowelPercent = 40;
+	bool pipeInput = false;
+	bool merge = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:c:n:m:l:v:i:M")) != -1) {
+		switch (opt) {
+			case 's':
+				server = optarg;
+				break;
+			case 'c':
+				client = optarg;
+				break;
+			case 'n':
+				nChildren = atoi(optarg);
+				break;
+			case 'm':
+				sizeMiB = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				if (!parse_line_length(optarg, &lineLength)) {
+					blg_perrorf("invalid line length: %s\n", optarg);
+				}
+				break;
+			case 'v':
+				vowelPercent = atoi(optarg);
+				break;
+			case 'i':
+				pipeInput = strcmp(optarg, "pipe") == 0;
+				break;
+			case 'M':
+				merge = true;
+				break;
+			default:
+				blg_perrorf("invalid pipeline options\n");
+		}
+	}
+
+	if (!server || !client || nChildren < 1) {
+		blg_perrorf("pipeline needs -s <server> and -c <client>\n");
+	}
+
+	// The server asks for one path per child, or a single one in merged mode.
+	int nOutputs = merge ? 1 : nChildren;
+
+	char dir[] = "/tmp/lab_1_bench.XXXXXX";
+	if (!mkdtemp(dir)) {
+		blg_perrorf("can't create a temporary directory\n");
+	}
+
+	char inputPath[PATH_MAX];
+	if (snprintf(inputPath, sizeof(inputPath), "%s/input", dir) >=
+	    (int)sizeof(inputPath)) {
+		blg_perrorf("benchmark input path is too long\n");
+	}
+
+	int input = open(inputPath, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (input == -1) {
+		blg_perrorf("can't create benchmark input\n");
+	}
+
+	// The server reads the output paths from stdin, followed by the text.
+	char(*outputPaths)[PATH_MAX] = malloc(nOutputs * sizeof(*outputPaths));
+	if (!outputPaths) {
+		blg_perrorf("can't allocate output paths\n");
+	}
+
+	for (int i = 0; i != nOutputs; ++i) {
+		if (snprintf(outputPaths[i], sizeof(outputPaths[i]), "%s/output-%d", dir,
+		             i) >= (int)sizeof(outputPaths[i])) {
+			blg_perrorf("benchmark output path is too long\n");
+		}
+
+		write_all(input, outputPaths[i], strlen(outputPaths[i]));
+		write_all(input, "\n", 1);
+	}
+
+	srand(123456);
+
+	size_t nBytes, nLines;
+	double generateStart = bench_now();
+	size_t expected = generate_input(input, sizeMiB * 1024 * 1024, &lineLength,
+	                                 vowelPercent, &nBytes, &nLines);
+	double generateSeconds = bench_now() - generateStart;
+
+	lseek(input, 0, SEEK_SET);
+
+	int feed[2] = {-1, -1};
+	if (pipeInput && pipe(feed) == -1) {
+		blg_perrorf("can't create pipe\n");
+	}
+
+	double runStart = bench_now();
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		blg_perrorf("can't fork\n");
+	}
+
+	if (pid == 0) {
+		int devNull = open("/dev/null", O_WRONLY);
+
+		if (dup2(pipeInput ? feed[0] : input, STDIN_FILENO) == -1 ||
+		    dup2(devNull, STDOUT_FILENO) == -1) {
+			blg_perrorf("can't redirect server's stdio\n");
+		}
+		if (pipeInput) {
+			close(feed[0]);
+			close(feed[1]);
+		}
+
+		char children[16];
+		snprintf(children, sizeof(children), "%d", nChildren);
+
+		if (merge) {
+			execl(server, server, "--merge", client, children, (char*)NULL);
+		} else {
+			execl(server, server, client, children, (char*)NULL);
+		}
+		blg_perrorf("can't exec into server\n");
+	}
+
+	if (pipeInput) {
+		close(feed[0]);
+
+		char buffer[64 * 1024];
+		ssize_t nRead;
+		while ((nRead = read(input, buffer, sizeof(buffer))) > 0) {
+			write_all(feed[1], buffer, nRead);
+		}
+
+		close(feed[1]);
+	}
+
+	// Keep the zombie around to read its counters, which include the
+	// children it reaped.
+	siginfo_t info;
+	if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1) {
+		blg_perrorf("can't wait for server\n");
+	}
+
+	double runSeconds = bench_now() - runStart;
+
+	ProcessStats stats;
+	read_stats(pid, &stats);
+
+	int status;
+	waitpid(pid, &status, 0);
+
+	size_t produced = 0;
+	for (int i = 0; i != nOutputs; ++i) {
+		struct stat st;
+		if (stat(outputPaths[i], &st) == 0) produced += st.st_size;
+		unlink(outputPaths[i]);
+	}
+	free(outputPaths);
+
+	close(input);
+	unlink(inputPath);
+	rmdir(dir);
+
+	bool valid = WIFEXITED(status) && WEXITSTATUS(status) == 0 && produced == expected;
+	double mib = (double)nBytes / (1024.0 * 1024.0);
+
+	blg_printf(
+	    "pipeline children=%d merge=%d input=%s bytes=%zu lines=%zu valid=%d "
+	    "generate_seconds=%f run_seconds=%f mib_per_s=%f lines_per_s=%f "
+	    "read_syscalls=%llu write_syscalls=%llu "
+	    "server_user=%f server_sys=%f children_user=%f children_sys=%f\n",
+	    nChildren, merge, pipeInput ? "pipe" : "file", nBytes, nLines, valid,
+	    generateSeconds, runSeconds, mib / runSeconds,
+	    (double)nLines / runSeconds, stats.syscr, stats.syscw, stats.user,
+	    stats.sys, stats.childrenUser, stats.childrenSys);
+
+	return valid ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bootleg_stdio.h"
+#include "process_spawn.h"
+
+typedef enum StartupMethod {
+	STARTUP_FORK,
+	STARTUP_SPAWN,
+	STARTUP_POOL,
+	STARTUP_COUNT,
+} StartupMethod;
+
+static const char* STARTUP_NAMES[STARTUP_COUNT] = {"fork", "spawn", "pool"};
+
+/** Line sent to every started client, and what should come back. */
+static const char PROBE[] = "startup\n";
+static const char PROBE_FILTERED[] = "strtp\n";
+
+static pid_t fork_process(const char* path, char* const argv[], int stdinFd,
+                          int stdoutFd) {
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (dup2(stdinFd, STDIN_FILENO) == -1 || dup2(stdoutFd, STDOUT_FILENO) == -1) {
+			_exit(127);
+		}
+
+		execv(path, argv);
+		_exit(127);
+	}
+
+	return pid;
+}
+
+/** Starts a client with the given method; pipes are returned in |worker|. */
+static bool start(StartupMethod method, SpawnPool* pool, const char* client,
+                  char* const argv[], SpawnedProcess* worker) {
+	if (method == STARTUP_POOL) {
+		return spawn_pool_take(pool, worker);
+	}
+
+	int input[2], output[2];
+	if (pipe2(input, O_CLOEXEC) == -1 || pipe2(output, O_CLOEXEC) == -1) {
+		blg_perrorf("can't create pipe\n");
+	}
+
+	pid_t pid = method == STARTUP_FORK
+	                ? fork_process(client, argv, input[0], output[1])
+	                : spawn_process(client, argv, input[0], output[1]);
+
+	close(input[0]);
+	close(output[1]);
+
+	if (pid == -1) {
+		close(input[1]);
+		close(output[0]);
+		return false;
+	}
+
+	*worker = (SpawnedProcess){pid, input[1], output[0]};
+	return true;
+}
+
+/** Sends the probe line and waits for the filtered one. */
+static bool round_trip(const SpawnedProcess* worker) {
+	if (write(worker->input, PROBE, sizeof(PROBE) - 1) != sizeof(PROBE) - 1) {
+		return false;
+	}
+
+	char buffer[sizeof(PROBE_FILTERED)];
+	size_t received = 0;
+
+	while (received != sizeof(PROBE_FILTERED) - 1) {
+		ssize_t nRead = read(worker->output, buffer + received,
+		                     sizeof(PROBE_FILTERED) - 1 - received);
+		if (nRead == -1 && errno == EINTR) continue;
+		if (nRead <= 0) return false;
+
+		received += nRead;
+	}
+
+	return memcmp(buffer, PROBE_FILTERED, received) == 0;
+}
+
+int bench_startup(int argc, char** argv) {
+	const char* client = NULL;
+	int runs = 100;
+	size_t residentMiB = 256;
+	int warmupMs = 20;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:r:w:")) != -1) {
+		switch (opt) {
+			case 'c':
+				client = optarg;
+				break;
+			case 'n':
+				runs = atoi(optarg);
+				break;
+			case 'r':
+				residentMiB = strtoul(optarg, NULL, 10);
+				break;
+			case 'w':
+				warmupMs = atoi(optarg);
+				break;
+			default:
+				blg_perrorf("invalid startup options\n");
+		}
+	}
+
+	if (!client || runs < 1) {
+		blg_perrorf("startup needs -c <client>\n");
+	}
+
+	// fork() copies page tables of the whole parent, so make it large, like a
+	// server that buffered a lot of input.
+	size_t residentSize = residentMiB * 1024 * 1024;
+	char* resident = (char*)malloc(residentSize ? residentSize : 1);
+	if (resident == NULL) {
+		blg_perrorf("can't allocate %zu MiB\n", residentMiB);
+	}
+	memset(resident, 1, residentSize);
+
+	char* clientArgs[] = {(char*)client, NULL};
+
+	SpawnPool* pool = spawn_pool_create(client, clientArgs, 1);
+	if (pool == NULL) {
+		blg_perrorf("can't create spawn pool\n");
+	}
+
+	int status = 0;
+
+	for (int method = 0; method != STARTUP_COUNT; ++method) {
+		double total = 0, min = 0, max = 0;
+		bool valid = true;
+
+		for (int i = 0; i != runs; ++i) {
+			if (method == STARTUP_POOL) {
+				// Let the replacement worker finish loading, as it would
+				// while the server waits for input.
+				if (!spawn_pool_fill(pool)) {
+					blg_perrorf("can't refill spawn pool\n");
+				}
+
+				struct timespec delay = {warmupMs / 1000, (warmupMs % 1000) * 1000000L};
+				nanosleep(&delay, NULL);
+			}
+
+			SpawnedProcess worker;
+			double startTime = bench_now();
+
+			if (!start((StartupMethod)method, pool, client, clientArgs, &worker)) {
+				blg_perrorf("can't start %s\n", client);
+			}
+			valid &= round_trip(&worker);
+
+			double elapsed = bench_now() - startTime;
+
+			close(worker.input);
+			close(worker.output);
+			waitpid(worker.pid, NULL, 0);
+
+			total += elapsed;
+			min = i == 0 || elapsed < min ? elapsed : min;
+			max = elapsed > max ? elapsed : max;
+		}
+
+		blg_printf(
+		    "startup method=%s runs=%d resident_mib=%zu valid=%d mean_us=%f "
+		    "min_us=%f max_us=%f\n",
+		    STARTUP_NAMES[method], runs, residentMiB, valid, total / runs * 1e6,
+		    min * 1e6, max * 1e6);
+
+		if (!valid) status = 1;
+	}
+
+	spawn_pool_destroy(pool);
+	free(resident);
+
+	return status;
+}
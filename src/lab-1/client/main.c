@@ -1,14 +1,13 @@
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bootleg_stdio.h"
-
-inline static bool is_vowel(char c) {
-	bool lowercase = c == 'a' || c == 'e' || c == 'o' || c == 'i' || c == 'u';
-	bool uppercase = c == 'A' || c == 'E' || c == 'O' || c == 'I' || c == 'U';
-	return lowercase || uppercase;
-}
+#include "frame.h"
+#include "line_reader.h"
+#include "vowel_filter.h"
 
 bool remove_vowels(const char* in, size_t inLength, char** out, size_t* outLength) {
 	if (in == NULL || inLength == 0 || out == NULL || outLength == NULL) {
@@ -19,12 +18,7 @@ bool remove_vowels(const char* in, size_t inLength, char** out, size_t* outLengt
 	if (*out == NULL) return false;
 
 	// Copy chars from |in|, excluding vowels.
-	size_t j = 0;
-	for (char* ptr = (char*)in; *ptr != '\0'; ++ptr) {
-		if (!is_vowel(*ptr)) {
-			(*out)[j++] = *ptr;
-		}
-	}
+	size_t j = filter_vowels(in, inLength, *out);
 
 	// Null-terminate the string.
 	(*out)[j] = '\0';
@@ -33,32 +27,168 @@ bool remove_vowels(const char* in, size_t inLength, char** out, size_t* outLengt
 	return true;
 }
 
-int main(int argc, char** argv) {
+/** Size of the blocks read in streaming mode. */
+static const size_t BLOCK_SIZE = 128 * 1024;
+
+/** Writes |length| bytes to stdout, retrying on partial writes. */
+static bool write_all(const char* data, size_t length) {
+	while (length) {
+		ssize_t written = write(STDOUT_FILENO, data, length);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	return true;
+}
+
+/**
+ * Filters stdin in large blocks. Removing vowels doesn't depend on line
+ * boundaries, so there's no need to look for them or to allocate per line.
+ */
+static void filter_stream(void) {
+	char* buffer = (char*)malloc(BLOCK_SIZE);
+	if (buffer == NULL) {
+		blg_perrorf("[child] can't allocate the buffer\n");
+	}
+
+	ssize_t nRead;
+
+	while ((nRead = read(STDIN_FILENO, buffer, BLOCK_SIZE))) {
+		if (nRead == -1) {
+			if (errno == EINTR) continue;
+
+			free(buffer);
+			blg_perrorf("[child] can't read from stdin\n");
+		}
+
+		size_t newLength = filter_vowels(buffer, nRead, buffer);
+
+		if (!write_all(buffer, newLength)) {
+			free(buffer);
+			blg_perrorf("[child] can't write to stdout\n");
+		}
+	}
+
+	free(buffer);
+}
+
+/**
+ * Reads exactly |length| bytes from stdin. Returns false on EOF before
+ * anything was read; exits on errors and truncated input.
+ */
+static bool read_exact(void* buf, size_t length) {
+	size_t total = 0;
+
+	while (total != length) {
+		ssize_t nRead = read(STDIN_FILENO, (char*)buf + total, length - total);
+		if (nRead == -1) {
+			if (errno == EINTR) continue;
+			blg_perrorf("[child] can't read from stdin\n");
+		}
+		if (nRead == 0) {
+			if (total == 0) return false;
+			blg_perrorf("[child] truncated frame\n");
+		}
+
+		total += nRead;
+	}
+
+	return true;
+}
+
+/**
+ * Filters sequence-numbered frames from the server and sends them back with
+ * the same numbers, so that the server can restore the input order.
+ */
+static void filter_frames(void) {
 	char* buffer = NULL;
+	size_t capacity = 0;
+
+	FrameHeader header;
+	while (read_exact(&header, sizeof(header))) {
+		if (header.length > capacity) {
+			char* newBuffer = (char*)realloc(buffer, header.length);
+			if (newBuffer == NULL) {
+				free(buffer);
+				blg_perrorf("[child] can't allocate the buffer\n");
+			}
+
+			buffer = newBuffer;
+			capacity = header.length;
+		}
+
+		if (!read_exact(buffer, header.length)) {
+			free(buffer);
+			blg_perrorf("[child] truncated frame\n");
+		}
+
+		header.length = filter_vowels(buffer, header.length, buffer);
+
+		if (!write_all((const char*)&header, sizeof(header)) ||
+		    !write_all(buffer, header.length)) {
+			free(buffer);
+			blg_perrorf("[child] can't write to stdout\n");
+		}
+	}
+
+	free(buffer);
+}
+
+/** Filters stdin line by line. */
+static void filter_lines(void) {
+	LineReader* reader = line_reader_create(STDIN_FILENO, LINE_READER_CAPACITY);
+	if (reader == NULL) {
+		blg_perrorf("[child] can't create line reader\n");
+	}
+
+	const char* line;
 	char* modified = NULL;
 	ssize_t nRead;
 
-	while ((nRead = blg_getline(&buffer, 0, STDIN_FILENO))) {
+	while ((nRead = line_reader_next(reader, &line))) {
 		if (nRead == -1) {
-			free(buffer);
+			line_reader_destroy(reader);
 			blg_perrorf("[child] can't read from stdin\n");
 		}
 
 		size_t newLength;
-		if (!remove_vowels(buffer, nRead, &modified, &newLength)) {
-			free(buffer);
+		if (!remove_vowels(line, nRead, &modified, &newLength)) {
+			line_reader_destroy(reader);
 			blg_perrorf("[child] can't modify the buffer\n");
 		}
 
 		if (write(STDOUT_FILENO, modified, newLength) == -1) {
-			free(buffer);
+			line_reader_destroy(reader);
 			free(modified);
 			blg_perrorf("[child] can't write to stdout\n");
 		}
 
-		free(buffer);
 		free(modified);
-		buffer = NULL;
 		modified = NULL;
 	}
+
+	line_reader_destroy(reader);
+}
+
+int main(int argc, char** argv) {
+	const char* mode = argc == 2 ? argv[1] : NULL;
+
+	if (argc > 2 ||
+	    (mode && strcmp(mode, "--lines") != 0 && strcmp(mode, "--framed") != 0)) {
+		blg_perrorf("usage: %s [--lines | --framed]\n", argv[0]);
+	}
+
+	// Stream by default; filtering line by line is only kept for comparison.
+	if (!mode) {
+		filter_stream();
+	} else if (strcmp(mode, "--lines") == 0) {
+		filter_lines();
+	} else {
+		filter_frames();
+	}
 }
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+
+#include "batch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+struct Batch {
+	/** Pipe to write to. */
+	int fd;
+	/** Gathered lines. */
+	char* buf;
+	/** Size of |buf|. */
+	size_t capacity;
+	/** Amount of bytes already written to the pipe. */
+	size_t offset;
+	/** Amount of bytes gathered in |buf|. */
+	size_t length;
+	/** File to splice the data from, if the batch isn't buffered. */
+	int splice_fd;
+	/** Offset of the data in |splice_fd| that wasn't spliced yet. */
+	off_t splice_offset;
+	/** Amount of bytes left to splice. */
+	size_t splice_length;
+};
+
+/** Returns the capacity of the pipe |fd|, or PIPE_BUF if it's unknown. */
+static size_t pipe_capacity(int fd) {
+#ifdef F_GETPIPE_SZ
+	int size = fcntl(fd, F_GETPIPE_SZ);
+	if (size > 0) return (size_t)size;
+#endif
+	return PIPE_BUF;
+}
+
+Batch* batch_create(int fd, size_t capacity) {
+	Batch* batch = (Batch*)malloc(sizeof(Batch));
+	if (batch == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if (capacity == 0) {
+		capacity = pipe_capacity(fd);
+	}
+
+	batch->buf = (char*)malloc(capacity);
+	if (batch->buf == NULL) {
+		free(batch);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	batch->fd = fd;
+	batch->capacity = capacity;
+	batch->offset = 0;
+	batch->length = 0;
+	batch->splice_fd = -1;
+	batch->splice_offset = 0;
+	batch->splice_length = 0;
+
+	return batch;
+}
+
+void batch_destroy(Batch* batch) {
+	if (!batch) return;
+
+	batch_flush(batch);
+
+	free(batch->buf);
+	free(batch);
+}
+
+int batch_fd(const Batch* batch) { return batch->fd; }
+
+size_t batch_capacity(const Batch* batch) { return batch->capacity; }
+
+/** Waits until |fd| becomes writable. */
+static bool wait_writable(int fd) {
+	struct pollfd pfd = {fd, POLLOUT, 0};
+	return poll(&pfd, 1, -1) != -1 || errno == EINTR;
+}
+
+/**
+ * Writes |length| bytes to |fd|, retrying on partial writes. If |fd| is
+ * non-blocking, waits until it becomes writable.
+ */
+static bool write_all(int fd, const char* data, size_t length) {
+	while (length) {
+		ssize_t written = write(fd, data, length);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				if (!wait_writable(fd)) return false;
+				continue;
+			}
+			return false;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	return true;
+}
+
+/**
+ * Splices as much of the scheduled data as the pipe accepts. Returns false on
+ * error; if the pipe is full, returns true and leaves the rest scheduled.
+ */
+static bool splice_some(Batch* batch) {
+	while (batch->splice_length) {
+		ssize_t spliced =
+		    splice(batch->splice_fd, &batch->splice_offset, batch->fd, NULL,
+		           batch->splice_length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (spliced == -1) {
+			if (errno == EINTR) continue;
+			return errno == EAGAIN;
+		}
+		if (spliced == 0) {
+			// The file was truncated.
+			return false;
+		}
+
+		batch->splice_length -= spliced;
+	}
+
+	return true;
+}
+
+bool batch_flush(Batch* batch) {
+	while (batch->splice_length) {
+		if (!splice_some(batch)) return false;
+		if (batch->splice_length && !wait_writable(batch->fd)) return false;
+	}
+
+	bool ok = write_all(batch->fd, batch->buf + batch->offset,
+	                    batch->length - batch->offset);
+	batch->offset = 0;
+	batch->length = 0;
+
+	return ok;
+}
+
+bool batch_send(Batch* batch) {
+	if (!splice_some(batch)) return false;
+	if (batch->splice_length) return true;
+
+	while (batch->offset != batch->length) {
+		ssize_t written = write(batch->fd, batch->buf + batch->offset,
+		                        batch->length - batch->offset);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+			return false;
+		}
+
+		batch->offset += written;
+	}
+
+	batch->offset = 0;
+	batch->length = 0;
+
+	return true;
+}
+
+bool batch_splice(Batch* batch, int fd, off_t offset, size_t length) {
+	if (batch_pending(batch)) {
+		errno = EBUSY;
+		return false;
+	}
+
+	batch->splice_fd = fd;
+	batch->splice_offset = offset;
+	batch->splice_length = length;
+
+	return true;
+}
+
+bool batch_fits(const Batch* batch, size_t length) {
+	return length <= batch->capacity - batch->length;
+}
+
+bool batch_append(Batch* batch, const char* line, size_t length) {
+	if (!batch_fits(batch, length)) {
+		if (!batch_flush(batch)) return false;
+
+		if (length > batch->capacity) {
+			return write_all(batch->fd, line, length);
+		}
+	}
+
+	memcpy(batch->buf + batch->length, line, length);
+	batch->length += length;
+
+	return true;
+}
+
+bool batch_pending(const Batch* batch) {
+	return batch->length != 0 || batch->splice_length != 0;
+}
+
+/** Returns the amount of bytes in the pipe that the child didn't read yet. */
+static size_t pipe_queued(int fd) {
+	int queued;
+	if (ioctl(fd, FIONREAD, &queued) == -1 || queued < 0) {
+		return 0;
+	}
+
+	return (size_t)queued;
+}
+
+size_t batch_load(const Batch* batch) {
+	return pipe_queued(batch->fd) + batch->length - batch->offset +
+	       batch->splice_length;
+}
+
+bool batch_writable(const Batch* batch) {
+	struct pollfd pfd = {batch->fd, POLLOUT, 0};
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+struct Batch;
+
+/** Lines gathered for one child, written to its pipe at once. */
+typedef struct Batch Batch;
+
+/**
+ * Creates a batch for the pipe |fd|. If |capacity| is zero, the batch is sized
+ * to the pipe's capacity. The pipe may be non-blocking.
+ */
+Batch* batch_create(int fd, size_t capacity);
+
+/** Flushes and destroys the batch. */
+void batch_destroy(Batch* batch);
+
+/** Returns the pipe the batch is written to. */
+int batch_fd(const Batch* batch);
+
+/** Returns the size of the batch's buffer. */
+size_t batch_capacity(const Batch* batch);
+
+/** Returns whether a line of |length| bytes fits in the batch. */
+bool batch_fits(const Batch* batch, size_t length);
+
+/**
+ * Appends a line to the batch, flushing the batch first if the line doesn't
+ * fit. Lines longer than the batch are written directly.
+ */
+bool batch_append(Batch* batch, const char* line, size_t length);
+
+/**
+ * Schedules |length| bytes of the file |fd| at |offset| to be spliced into the
+ * pipe, without copying them through user space. The batch must be empty.
+ */
+bool batch_splice(Batch* batch, int fd, off_t offset, size_t length);
+
+/** Writes the gathered lines to the pipe, waiting until all are written. */
+bool batch_flush(Batch* batch);
+
+/**
+ * Writes as much of the gathered lines as the pipe accepts without blocking.
+ * The rest stays in the batch; see |batch_pending|.
+ */
+bool batch_send(Batch* batch);
+
+/** Returns whether the batch has any lines that weren't written yet. */
+bool batch_pending(const Batch* batch);
+
+/** Returns the amount of bytes waiting for the child: in the pipe and in the batch. */
+size_t batch_load(const Batch* batch);
+
+/** Returns whether the pipe has room for more data. */
+bool batch_writable(const Batch* batch);
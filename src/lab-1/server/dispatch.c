@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+
+#include "dispatch.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bootleg_stdio.h"
+
+/** Time after which gathered lines are sent to children if there's no input. */
+static const int IDLE_TIMEOUT_MS = 10;
+
+/**
+ * Waits until stdin is readable, sending pending batches to children whose
+ * pipes become writable meanwhile. Returns false on timeout.
+ */
+static bool wait_for_input(Batch** batches, int nChildren, int timeout) {
+	struct pollfd fds[nChildren + 1];
+	int children[nChildren];
+
+	while (true) {
+		fds[0] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+
+		int nFds = 1;
+		for (int i = 0; i != nChildren; ++i) {
+			if (batch_pending(batches[i])) {
+				fds[nFds] = (struct pollfd){batch_fd(batches[i]), POLLOUT, 0};
+				children[nFds - 1] = i;
+				++nFds;
+			}
+		}
+
+		int ready = poll(fds, nFds, timeout);
+		if (ready == -1) {
+			if (errno == EINTR) continue;
+			blg_perrorf("can't poll stdin\n");
+		}
+		if (ready == 0) return false;
+		if (fds[0].revents) return true;
+
+		for (int i = 1; i != nFds; ++i) {
+			if (fds[i].revents && !batch_send(batches[children[i - 1]])) {
+				blg_perrorf("can't write to pipe\n");
+			}
+		}
+	}
+}
+
+/**
+ * Picks the child to gather the next batch for: the least loaded one, whose
+ * pipe is writable and which doesn't have a batch in flight. If there's no such
+ * child, waits until one of them drains its batch.
+ */
+static int pick_child(Batch** batches, int nChildren) {
+	struct pollfd fds[nChildren];
+
+	while (true) {
+		int best = -1;
+		size_t bestLoad = 0;
+
+		for (int i = 0; i != nChildren; ++i) {
+			if (batch_pending(batches[i]) || !batch_writable(batches[i])) {
+				continue;
+			}
+
+			size_t load = batch_load(batches[i]);
+			if (best == -1 || load < bestLoad) {
+				best = i;
+				bestLoad = load;
+			}
+		}
+
+		if (best != -1) return best;
+
+		// Every child is busy: wait until one of the pipes has some room.
+		for (int i = 0; i != nChildren; ++i) {
+			fds[i] = (struct pollfd){batch_fd(batches[i]), POLLOUT, 0};
+		}
+
+		if (poll(fds, nChildren, -1) == -1 && errno != EINTR) {
+			blg_perrorf("can't poll pipes\n");
+		}
+
+		for (int i = 0; i != nChildren; ++i) {
+			if (fds[i].revents && batch_pending(batches[i]) &&
+			    !batch_send(batches[i])) {
+				blg_perrorf("can't write to pipe\n");
+			}
+		}
+	}
+}
+
+void dispatch_lines(LineReader* reader, Batch** batches, int nChildren) {
+	// Child that the current batch is gathered for.
+	int target = -1;
+
+	const char* line;
+	ssize_t nRead;
+
+	while (true) {
+		// Don't hold on to the gathered lines if the input is idle.
+		if (!line_reader_ready(reader) &&
+		    !wait_for_input(batches, nChildren, IDLE_TIMEOUT_MS)) {
+			if (target != -1 && !batch_send(batches[target])) {
+				blg_perrorf("can't write to pipe\n");
+			}
+			target = -1;
+
+			// A full pipe takes only part of the batch. Keep sending the rest
+			// while waiting, instead of blocking in read() with it queued.
+			wait_for_input(batches, nChildren, -1);
+		}
+
+		if ((nRead = line_reader_next(reader, &line)) == 0) {
+			break;
+		}
+
+		if (nRead == -1) {
+			blg_perrorf("can't read from stdin\n");
+		}
+
+		// The batch is full, send it and start a new one.
+		if (target != -1 && !batch_fits(batches[target], nRead)) {
+			if (!batch_send(batches[target])) {
+				blg_perrorf("can't write to pipe\n");
+			}
+			target = -1;
+		}
+
+		if (target == -1) {
+			target = pick_child(batches, nChildren);
+		}
+
+		if (!batch_append(batches[target], line, nRead)) {
+			blg_perrorf("can't write to pipe\n");
+		}
+	}
+}
+
+bool dispatch_spliced(LineReader* reader, int fd, Batch** batches, int nChildren) {
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+
+	off_t position = lseek(fd, 0, SEEK_CUR);
+	if (position == -1 || position > st.st_size) {
+		return false;
+	}
+
+	// Start from the data that the reader has buffered, but not consumed.
+	size_t size = (size_t)st.st_size;
+	size_t offset = (size_t)position - line_reader_buffered(reader);
+
+	// The file is mapped only to look for line separators; the data itself
+	// goes from the page cache to the pipes. The buffered tail needs the
+	// mapping too, even if the reader has reached the end of the file.
+	char* data = NULL;
+
+	if (offset != size) {
+		data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+
+		madvise(data, size, MADV_SEQUENTIAL);
+	}
+
+	while (offset != size) {
+		int target = pick_child(batches, nChildren);
+
+		// Cut the chunk after the last line separator that fits in the pipe.
+		// If a single line doesn't fit, send it whole.
+		size_t end = offset + batch_capacity(batches[target]);
+		if (end >= size) {
+			end = size;
+		} else {
+			char* separator = (char*)memrchr(data + offset, '\n', end - offset);
+			if (!separator) {
+				separator = (char*)memchr(data + end, '\n', size - end);
+			}
+
+			end = separator ? (size_t)(separator - data) + 1 : size;
+		}
+
+		if (!batch_splice(batches[target], fd, (off_t)offset, end - offset) ||
+		    !batch_send(batches[target])) {
+			blg_perrorf("can't splice to pipe\n");
+		}
+
+		offset = end;
+	}
+
+	if (data) munmap(data, size);
+	return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "batch.h"
+#include "line_reader.h"
+
+/**
+ * Reads lines from |reader| and sends them to children in batches. Every batch
+ * goes to the least loaded child that can accept it.
+ */
+void dispatch_lines(LineReader* reader, Batch** batches, int nChildren);
+
+/**
+ * Sends the rest of the regular file |fd| to children, splicing it into the
+ * pipes in chunks cut at line boundaries. |reader| holds the data that was read
+ * from |fd| already; it's dispatched first. Returns false if |fd| can't be
+ * mapped, before anything is sent.
+ */
+bool dispatch_spliced(LineReader* reader, int fd, Batch** batches, int nChildren);
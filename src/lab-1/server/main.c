@@ -1,30 +1,55 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
 #include <sys/wait.h>
 
+#include "batch.h"
 #include "bootleg_stdio.h"
-
-int open_file(int fileNo) {
+#include "dispatch.h"
+#include "line_reader.h"
+#include "merge.h"
+#include "process_spawn.h"
+
+/**
+ * Largest number of children. Each one takes an output file and a pipe, which
+ * keeps well within the default limit of 1024 open files.
+ */
+static const long MAX_CHILDREN = 256;
+
+int open_file(LineReader* reader, int fileNo) {
 	char msg[64];
 	snprintf(msg, sizeof(msg), "Enter (%d) output file path: ", fileNo);
-	if (write(STDIN_FILENO, msg, strlen(msg)) == -1) {
+	if (write(STDOUT_FILENO, msg, strlen(msg)) == -1) {
 		blg_perrorf("can't write to stdout (1)");
 	}
 
-	char path[PATH_MAX];
-	size_t nRead = read(STDIN_FILENO, &path, sizeof(path) - 1);
+	// Read the path through |reader|, so that the input following it stays
+	// buffered for the dispatcher.
+	const char* line;
+	ssize_t nRead = line_reader_next(reader, &line);
 	if (nRead == -1) {
 		blg_perrorf("can't read (%d) output file path\n", fileNo);
 	}
 	// Remove line separator if it's present
-	if (nRead > 0 && path[nRead - 1] == '\n') {
-		path[nRead - 1] = '\0';
+	if (nRead > 0 && line[nRead - 1] == '\n') {
+		--nRead;
 	}
+	if (nRead >= PATH_MAX) {
+		blg_perrorf("(%d) output file path is too long\n", fileNo);
+	}
+
+	char path[PATH_MAX];
+	memcpy(path, line, nRead);
+	path[nRead] = '\0';
 
-	int file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
+	int file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+	                S_IRUSR | S_IWUSR);
 	if (file == -1) {
 		blg_perrorf("can't open (%d) output file for writing\n", fileNo);
 	}
@@ -33,75 +58,132 @@ int open_file(int fileNo) {
 }
 
 int main(int argc, char** argv) {
-	if (argc != 2) {
-		blg_perrorf("usage: %s <client program>\n", argv[0]);
+	// Merged mode: children return results, which are written to a single file
+	// in the input order.
+	bool merge = argc > 1 && strcmp(argv[1], "--merge") == 0;
+	if (merge) {
+		--argc;
+		++argv;
+	}
+
+	if (argc != 2 && argc != 3) {
+		blg_perrorf("usage: %s [--merge] <client program> [children]\n", argv[0]);
 	}
 
 	char* client = argv[1];
-	const int nChildren = 2;
 
-	int files[nChildren];
-	for (int i = 0; i != nChildren; ++i) {
-		files[i] = open_file(i + 1);
+	int nChildren = 2;
+	if (argc == 3) {
+		char* end;
+		long value = strtol(argv[2], &end, 10);
+		if (*end != '\0' || value < 1 || value > MAX_CHILDREN) {
+			blg_perrorf("invalid number of children: %s (1 to %ld)\n", argv[2],
+			            MAX_CHILDREN);
+		}
+
+		nChildren = (int)value;
+
+		// The count also sets the amount of output files, so it's honoured
+		// even if the children have to share cores.
+		long nCores = sysconf(_SC_NPROCESSORS_ONLN);
+		if (nCores > 0 && value > nCores) {
+			dprintf(STDERR_FILENO,
+			        "warning: %d children on %ld cores, they will share cores\n",
+			        nChildren, nCores);
+		}
+	}
+
+	LineReader* reader = line_reader_create(STDIN_FILENO, LINE_READER_CAPACITY);
+	if (reader == NULL) {
+		blg_perrorf("can't create line reader\n");
+	}
+
+	// Merged-mode children don't depend on the output file, so they are
+	// started before the prompts and are warm by the time input arrives.
+	char* clientArgs[] = {client, merge ? "--framed" : NULL, NULL};
+	SpawnPool* pool = NULL;
+	if (merge) {
+		pool = spawn_pool_create(client, clientArgs, nChildren);
+		if (pool == NULL) {
+			blg_perrorf("can't start children\n");
+		}
+	}
+
+	int nFiles = merge ? 1 : nChildren;
+	int files[nFiles];
+	for (int i = 0; i != nFiles; ++i) {
+		files[i] = open_file(reader, i + 1);
+	}
+
+	if (merge) {
+		int inputs[nChildren];
+		int outputs[nChildren];
+		for (int i = 0; i != nChildren; ++i) {
+			SpawnedProcess worker;
+			spawn_pool_take(pool, &worker);
+
+			inputs[i] = worker.input;
+			outputs[i] = worker.output;
+		}
+		spawn_pool_destroy(pool);
+
+		// Closes |inputs| when all input is sent.
+		dispatch_merged(reader, inputs, outputs, nChildren, files[0]);
+		line_reader_destroy(reader);
+
+		for (int i = 0; i != nChildren; ++i) {
+			close(outputs[i]);
+		}
+
+		while (wait(NULL) > 0)
+			;
+		return 0;
 	}
 
+	// Pipes are close-on-exec, so each child only gets its own read end.
 	int pipes[nChildren][2];
 	for (int i = 0; i != nChildren; ++i) {
-		if (pipe(pipes[i]) == -1) {
+		if (pipe2(pipes[i], O_CLOEXEC) == -1) {
 			blg_perrorf("can't create pipe (%d)\n", i);
 		}
 	}
 
 	for (int i = 0; i != nChildren; ++i) {
-		pid_t child = fork();
-		if (child == -1) {
-			blg_perrorf("can't fork on child %d\n", i);
+		if (spawn_process(client, clientArgs, pipes[i][STDIN_FILENO], files[i]) == -1) {
+			blg_perrorf("can't start child %d\n", i);
 		}
 
-		if (child == 0) {
-			for (int j = 0; j != nChildren; ++j) {
-				if (i != j) {
-					close(pipes[j][STDIN_FILENO]);
-					close(pipes[j][STDOUT_FILENO]);
-				}
-			}
-
-			if (dup2(pipes[i][STDIN_FILENO], STDIN_FILENO) == -1) {
-				blg_perrorf("can't redirect child's stdin to pipe\n");
-			}
-			if (dup2(files[i], STDOUT_FILENO) == -1) {
-				blg_perrorf("can't redirect child's stdout to file\n");
-			}
-			close(pipes[i][STDOUT_FILENO]);
-
-			if (execl(/* path */ client, /* argv[0] */ client, (char*)NULL) == -1) {
-				blg_perrorf("can't exec into child\n");
-			}
-		} else {
-			close(pipes[i][STDIN_FILENO]);
-		}
+		close(pipes[i][STDIN_FILENO]);
 	}
 
-	char* buffer = NULL;
-	ssize_t nRead;
-
-	for (int i = 0; (nRead = blg_getline(&buffer, 0, STDIN_FILENO)) != 0; ++i) {
-		if (nRead == -1) {
-			free(buffer);
-			blg_perrorf("can't read from stdin\n");
+	Batch* batches[nChildren];
+	for (int i = 0; i != nChildren; ++i) {
+		// A full pipe must not block the other children.
+		int flags = fcntl(pipes[i][STDOUT_FILENO], F_GETFL);
+		if (flags == -1 ||
+		    fcntl(pipes[i][STDOUT_FILENO], F_SETFL, flags | O_NONBLOCK) == -1) {
+			blg_perrorf("can't make pipe (%d) non-blocking\n", i);
 		}
 
-		int* pipe = pipes[i % nChildren];
-		if (write(pipe[STDOUT_FILENO], buffer, nRead) == -1) {
-			free(buffer);
-			blg_perrorf("can't write to pipe\n");
+		batches[i] = batch_create(pipes[i][STDOUT_FILENO], 0);
+		if (batches[i] == NULL) {
+			blg_perrorf("can't create batch (%d)\n", i);
 		}
+	}
 
-		free(buffer);
-		buffer = NULL;
+	// Regular files are spliced into the pipes without copying.
+	if (!dispatch_spliced(reader, STDIN_FILENO, batches, nChildren)) {
+		dispatch_lines(reader, batches, nChildren);
 	}
 
-	for (size_t i = 0; i != nChildren; ++i) {
+	line_reader_destroy(reader);
+
+	for (int i = 0; i != nChildren; ++i) {
+		if (!batch_flush(batches[i])) {
+			blg_perrorf("can't write to pipe\n");
+		}
+		batch_destroy(batches[i]);
+
 		close(pipes[i][STDOUT_FILENO]);
 	}
 
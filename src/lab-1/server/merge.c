@@ -0,0 +1,326 @@
+#include "merge.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bootleg_stdio.h"
+#include "frame.h"
+
+/** Target size of a frame's payload; the last line may overshoot it. */
+static const size_t FRAME_SIZE = 64 * 1024;
+
+/** Amount of frames per child that may be in flight at once. */
+static const size_t FRAMES_PER_CHILD = 4;
+
+typedef struct Buffer {
+	char* data;
+	/** Amount of bytes in |data|. */
+	size_t length;
+	/** Size of |data|. */
+	size_t capacity;
+} Buffer;
+
+typedef struct Worker {
+	/** Pipe to the child. */
+	int input;
+	/** Pipe from the child. */
+	int output;
+	/** Frame that is being sent to the child. */
+	Buffer send;
+	/** Amount of bytes of |send| that were already written. */
+	size_t sent;
+	/** Data received from the child, which doesn't make a whole frame yet. */
+	Buffer recv;
+	/** Amount of frames sent to the child, but not received back. */
+	size_t inFlight;
+	/** Whether |input| was closed. */
+	bool closed;
+	/** Whether |output| has reached EOF. */
+	bool done;
+} Worker;
+
+/** Result frame waiting in the reorder buffer. */
+typedef struct Slot {
+	Buffer data;
+	bool ready;
+} Slot;
+
+static void buffer_reserve(Buffer* buffer, size_t capacity) {
+	if (capacity <= buffer->capacity) return;
+
+	if (capacity < buffer->capacity * 2) {
+		capacity = buffer->capacity * 2;
+	}
+
+	char* data = (char*)realloc(buffer->data, capacity);
+	if (data == NULL) {
+		blg_perrorf("can't allocate %zu bytes\n", capacity);
+	}
+
+	buffer->data = data;
+	buffer->capacity = capacity;
+}
+
+static void set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		blg_perrorf("can't make pipe non-blocking\n");
+	}
+}
+
+/**
+ * Gathers buffered lines from |reader| into a frame for |worker|, without
+ * waiting for more input. Returns false if there were no lines; sets |eof|
+ * when the input ends.
+ */
+static bool build_frame(LineReader* reader, Worker* worker, uint64_t seq, bool* eof) {
+	Buffer* send = &worker->send;
+	send->length = sizeof(FrameHeader);
+
+	size_t payload = 0;
+	while (payload < FRAME_SIZE && line_reader_ready(reader)) {
+		const char* line;
+		ssize_t nRead = line_reader_next(reader, &line);
+
+		if (nRead == -1) {
+			blg_perrorf("can't read from stdin\n");
+		}
+		if (nRead == 0) {
+			*eof = true;
+			break;
+		}
+
+		buffer_reserve(send, send->length + nRead);
+		memcpy(send->data + send->length, line, nRead);
+		send->length += nRead;
+		payload += nRead;
+	}
+
+	if (payload == 0) {
+		send->length = 0;
+		return false;
+	}
+
+	FrameHeader header = {seq, payload};
+	memcpy(send->data, &header, sizeof(header));
+
+	worker->sent = 0;
+	++worker->inFlight;
+
+	return true;
+}
+
+/** Writes as much of the pending frame as the pipe accepts. */
+static void send_some(Worker* worker) {
+	while (worker->sent != worker->send.length) {
+		ssize_t written = write(worker->input, worker->send.data + worker->sent,
+		                        worker->send.length - worker->sent);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+			blg_perrorf("can't write to pipe\n");
+		}
+
+		worker->sent += written;
+	}
+
+	worker->send.length = 0;
+	worker->sent = 0;
+}
+
+/** Reads the child's results and moves whole frames to the reorder buffer. */
+static void receive(Worker* worker, Slot* slots, size_t window) {
+	Buffer* recv = &worker->recv;
+	buffer_reserve(recv, recv->length + FRAME_SIZE);
+
+	ssize_t nRead = read(worker->output, recv->data + recv->length,
+	                     recv->capacity - recv->length);
+	if (nRead == -1) {
+		if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) return;
+		blg_perrorf("can't read from child\n");
+	}
+	if (nRead == 0) {
+		worker->done = true;
+		return;
+	}
+
+	recv->length += nRead;
+
+	size_t offset = 0;
+	while (recv->length - offset >= sizeof(FrameHeader)) {
+		FrameHeader header;
+		memcpy(&header, recv->data + offset, sizeof(header));
+
+		if (recv->length - offset - sizeof(header) < header.length) {
+			break;
+		}
+
+		Slot* slot = &slots[header.seq % window];
+		buffer_reserve(&slot->data, header.length);
+		memcpy(slot->data.data, recv->data + offset + sizeof(header), header.length);
+		slot->data.length = header.length;
+		slot->ready = true;
+
+		offset += sizeof(header) + header.length;
+		--worker->inFlight;
+	}
+
+	// Keep the incomplete frame at the beginning of the buffer.
+	memmove(recv->data, recv->data + offset, recv->length - offset);
+	recv->length -= offset;
+}
+
+/** Returns the idle child with the least frames in flight, or -1. */
+static int pick_worker(Worker* workers, int nChildren) {
+	int best = -1;
+
+	for (int i = 0; i != nChildren; ++i) {
+		Worker* worker = &workers[i];
+		if (worker->send.length || worker->closed || worker->done) continue;
+
+		if (best == -1 || worker->inFlight < workers[best].inFlight) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+void dispatch_merged(LineReader* reader, int* inputs, int* outputs, int nChildren,
+                     int outputFile) {
+	Worker workers[nChildren];
+	memset(workers, 0, sizeof(workers));
+
+	for (int i = 0; i != nChildren; ++i) {
+		workers[i].input = inputs[i];
+		workers[i].output = outputs[i];
+
+		set_nonblocking(inputs[i]);
+		set_nonblocking(outputs[i]);
+	}
+
+	// Frames are stored at |seq % window|; the window bounds the memory used.
+	size_t window = FRAMES_PER_CHILD * nChildren;
+	Slot* slots = (Slot*)calloc(window, sizeof(Slot));
+	if (slots == NULL) {
+		blg_perrorf("can't allocate the reorder buffer\n");
+	}
+
+	BlgWriter* writer = blg_writer_create(outputFile, FRAME_SIZE);
+	if (writer == NULL) {
+		blg_perrorf("can't create output buffer\n");
+	}
+
+	// Sequence number of the next frame to send and to write out.
+	uint64_t nextSeq = 0;
+	uint64_t emitSeq = 0;
+	bool inputDone = false;
+
+	struct pollfd fds[2 * nChildren + 1];
+	// Worker index for every polled fd; -1 for stdin.
+	int owners[2 * nChildren + 1];
+
+	while (true) {
+		// Send frames while there are buffered lines and room in the window.
+		while (!inputDone && nextSeq - emitSeq < window &&
+		       line_reader_ready(reader)) {
+			int target = pick_worker(workers, nChildren);
+			if (target == -1) break;
+
+			if (!build_frame(reader, &workers[target], nextSeq, &inputDone)) break;
+
+			++nextSeq;
+			send_some(&workers[target]);
+		}
+
+		// Let children exit once they got all the input.
+		if (inputDone) {
+			for (int i = 0; i != nChildren; ++i) {
+				if (!workers[i].closed && !workers[i].send.length) {
+					close(workers[i].input);
+					workers[i].closed = true;
+				}
+			}
+
+			if (emitSeq == nextSeq) break;
+		}
+
+		int nFds = 0;
+
+		bool canSend = !inputDone && nextSeq - emitSeq < window &&
+		               pick_worker(workers, nChildren) != -1;
+		if (canSend && !line_reader_ready(reader)) {
+			fds[nFds] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+			owners[nFds++] = -1;
+		}
+
+		for (int i = 0; i != nChildren; ++i) {
+			if (workers[i].send.length) {
+				fds[nFds] = (struct pollfd){workers[i].input, POLLOUT, 0};
+				owners[nFds++] = i;
+			}
+			if (!workers[i].done) {
+				fds[nFds] = (struct pollfd){workers[i].output, POLLIN, 0};
+				owners[nFds++] = i;
+			}
+		}
+
+		if (nFds == 0) {
+			blg_perrorf("children exited before returning all results\n");
+		}
+
+		if (poll(fds, nFds, -1) == -1) {
+			if (errno == EINTR) continue;
+			blg_perrorf("can't poll pipes\n");
+		}
+
+		for (int i = 0; i != nFds; ++i) {
+			if (!fds[i].revents) continue;
+
+			if (owners[i] == -1) {
+				if (line_reader_fill(reader) == -1) {
+					blg_perrorf("can't read from stdin\n");
+				}
+			} else if (fds[i].events == POLLOUT) {
+				send_some(&workers[owners[i]]);
+			} else {
+				Worker* worker = &workers[owners[i]];
+				receive(worker, slots, window);
+
+				if (worker->done && worker->inFlight) {
+					blg_perrorf("child exited before returning all results\n");
+				}
+			}
+		}
+
+		// Write out the frames that are next in order.
+		while (slots[emitSeq % window].ready) {
+			Slot* slot = &slots[emitSeq % window];
+
+			if (!blg_writer_write(writer, slot->data.data, slot->data.length)) {
+				blg_perrorf("can't write to output file\n");
+			}
+
+			slot->ready = false;
+			++emitSeq;
+		}
+	}
+
+	blg_writer_destroy(writer);
+
+	for (size_t i = 0; i != window; ++i) {
+		free(slots[i].data.data);
+	}
+	free(slots);
+
+	for (int i = 0; i != nChildren; ++i) {
+		free(workers[i].send.data);
+		free(workers[i].recv.data);
+	}
+}
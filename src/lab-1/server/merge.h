@@ -0,0 +1,14 @@
+#pragma once
+
+#include "line_reader.h"
+
+/**
+ * Sends lines from |reader| to children in sequence-numbered frames and writes
+ * the filtered frames they return to |outputFile| in the original order.
+ *
+ * |inputs| are the pipes to the children, |outputs| are the pipes from them.
+ * At most a few frames per child are in flight at once; while the reorder
+ * buffer is full, no new input is dispatched.
+ */
+void dispatch_merged(LineReader* reader, int* inputs, int* outputs, int nChildren,
+                     int outputFile);
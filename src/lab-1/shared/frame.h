@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Header of a frame exchanged between the server and children in merged
+ * output mode. It's followed by |length| bytes of whole lines.
+ */
+typedef struct FrameHeader {
+	/** Position of the frame in the input; results are emitted in this order. */
+	uint64_t seq;
+	/** Length of the payload. */
+	uint64_t length;
+} FrameHeader;
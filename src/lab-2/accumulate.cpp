@@ -0,0 +1,337 @@
+#include "accumulate.h"
+
+#if defined(__x86_64__)
+#define ACCUMULATE_X86
+#include <immintrin.h>
+
+static_assert(sizeof(long) == sizeof(long long), "kernels add 64-bit lanes");
+#endif
+
+namespace {
+
+/** Amount of rows added in a single pass over the result. */
+constexpr size_t ROWS_PER_PASS = 8;
+
+template <class T, class A, size_t N>
+void add_rows_scalar(A* result, const T* data, size_t stride, size_t length) {
+	for (size_t j = 0; j != length; ++j) {
+		A sum = result[j];
+		for (size_t r = 0; r != N; ++r) {
+			sum += static_cast<A>(data[r * stride + j]);
+		}
+		result[j] = sum;
+	}
+}
+
+#ifdef ACCUMULATE_X86
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+// Lane operations for each element type. Accumulators are 64-bit for every
+// type; |widen| loads as many elements as there are lanes and converts them.
+
+template <class T>
+struct sse2_ops;
+
+template <>
+struct sse2_ops<long> {
+	using vector = __m128i;
+
+	SSE2 static vector load(const long* p) {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	}
+	SSE2 static vector widen(const long* p) { return load(p); }
+	SSE2 static vector add(vector a, vector b) { return _mm_add_epi64(a, b); }
+	SSE2 static void store(long* p, vector v) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+	}
+};
+
+template <>
+struct sse2_ops<int32_t> : sse2_ops<long> {
+	SSE2 static vector widen(const int32_t* p) {
+		// SSE2 has no sign extension; interleave with the sign bits instead.
+		__m128i items = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+		return _mm_unpacklo_epi32(items, _mm_srai_epi32(items, 31));
+	}
+};
+
+template <>
+struct sse2_ops<double> {
+	using vector = __m128d;
+
+	SSE2 static vector load(const double* p) { return _mm_loadu_pd(p); }
+	SSE2 static vector widen(const double* p) { return load(p); }
+	SSE2 static vector add(vector a, vector b) { return _mm_add_pd(a, b); }
+	SSE2 static void store(double* p, vector v) { _mm_storeu_pd(p, v); }
+};
+
+template <>
+struct sse2_ops<float> : sse2_ops<double> {
+	SSE2 static vector widen(const float* p) {
+		__m128i items = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+		return _mm_cvtps_pd(_mm_castsi128_ps(items));
+	}
+};
+
+template <class T>
+struct avx2_ops;
+
+template <>
+struct avx2_ops<long> {
+	using vector = __m256i;
+
+	AVX2 static vector load(const long* p) {
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+	AVX2 static vector widen(const long* p) { return load(p); }
+	AVX2 static vector add(vector a, vector b) { return _mm256_add_epi64(a, b); }
+	AVX2 static void store(long* p, vector v) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+	}
+};
+
+template <>
+struct avx2_ops<int32_t> : avx2_ops<long> {
+	AVX2 static vector widen(const int32_t* p) {
+		return _mm256_cvtepi32_epi64(
+		    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+	}
+};
+
+template <>
+struct avx2_ops<double> {
+	using vector = __m256d;
+
+	AVX2 static vector load(const double* p) { return _mm256_loadu_pd(p); }
+	AVX2 static vector widen(const double* p) { return load(p); }
+	AVX2 static vector add(vector a, vector b) { return _mm256_add_pd(a, b); }
+	AVX2 static void store(double* p, vector v) { _mm256_storeu_pd(p, v); }
+};
+
+template <>
+struct avx2_ops<float> : avx2_ops<double> {
+	AVX2 static vector widen(const float* p) {
+		return _mm256_cvtps_pd(_mm_loadu_ps(p));
+	}
+};
+
+// AVX-512 operations are masked, so that the tail needs no scalar loop.
+
+/**
+ * Returns the lower half of |v|. Same as _mm512_castsi512_si256(), which
+ * trips -Wmaybe-uninitialized in GCC 12 headers.
+ */
+AVX512 __m256i lower_half(__m512i v) {
+	return _mm512_maskz_extracti64x4_epi64(0xF, v, 0);
+}
+
+template <class T>
+struct avx512_ops;
+
+template <>
+struct avx512_ops<long> {
+	using vector = __m512i;
+
+	AVX512 static vector load(__mmask8 mask, const long* p) {
+		return _mm512_maskz_loadu_epi64(mask, p);
+	}
+	AVX512 static vector widen(__mmask8 mask, const long* p) {
+		return load(mask, p);
+	}
+	AVX512 static vector add(vector a, vector b) { return _mm512_add_epi64(a, b); }
+	AVX512 static void store(long* p, __mmask8 mask, vector v) {
+		_mm512_mask_storeu_epi64(p, mask, v);
+	}
+};
+
+template <>
+struct avx512_ops<int32_t> : avx512_ops<long> {
+	AVX512 static vector widen(__mmask8 mask, const int32_t* p) {
+		__m512i items = _mm512_maskz_loadu_epi32(mask, p);
+		return _mm512_maskz_cvtepi32_epi64(mask, lower_half(items));
+	}
+};
+
+template <>
+struct avx512_ops<double> {
+	using vector = __m512d;
+
+	AVX512 static vector load(__mmask8 mask, const double* p) {
+		return _mm512_maskz_loadu_pd(mask, p);
+	}
+	AVX512 static vector widen(__mmask8 mask, const double* p) {
+		return load(mask, p);
+	}
+	AVX512 static vector add(vector a, vector b) { return _mm512_add_pd(a, b); }
+	AVX512 static void store(double* p, __mmask8 mask, vector v) {
+		_mm512_mask_storeu_pd(p, mask, v);
+	}
+};
+
+template <>
+struct avx512_ops<float> : avx512_ops<double> {
+	AVX512 static vector widen(__mmask8 mask, const float* p) {
+		__m512 items = _mm512_maskz_loadu_ps(mask, p);
+		__m256i lower = lower_half(_mm512_castps_si512(items));
+		return _mm512_maskz_cvtps_pd(mask, _mm256_castsi256_ps(lower));
+	}
+};
+
+template <class T, class A, size_t N>
+SSE2 void add_rows_sse2(A* result, const T* data, size_t stride,
+                        size_t length) {
+	using ops = sse2_ops<T>;
+	size_t j = 0;
+
+	for (; j + 2 <= length; j += 2) {
+		auto sum = ops::load(result + j);
+		for (size_t r = 0; r != N; ++r) {
+			sum = ops::add(sum, ops::widen(data + r * stride + j));
+		}
+		ops::store(result + j, sum);
+	}
+
+	add_rows_scalar<T, A, N>(result + j, data + j, stride, length - j);
+}
+
+template <class T, class A, size_t N>
+AVX2 void add_rows_avx2(A* result, const T* data, size_t stride,
+                        size_t length) {
+	using ops = avx2_ops<T>;
+	size_t j = 0;
+
+	for (; j + 4 <= length; j += 4) {
+		auto sum = ops::load(result + j);
+		for (size_t r = 0; r != N; ++r) {
+			sum = ops::add(sum, ops::widen(data + r * stride + j));
+		}
+		ops::store(result + j, sum);
+	}
+
+	add_rows_scalar<T, A, N>(result + j, data + j, stride, length - j);
+}
+
+template <class T, class A, size_t N>
+AVX512 void add_rows_avx512(A* result, const T* data, size_t stride,
+                            size_t length) {
+	using ops = avx512_ops<T>;
+
+	for (size_t j = 0; j < length; j += 8) {
+		__mmask8 mask = length - j >= 8 ? 0xFF : (1u << (length - j)) - 1;
+
+		auto sum = ops::load(mask, result + j);
+		for (size_t r = 0; r != N; ++r) {
+			sum = ops::add(sum, ops::widen(mask, data + r * stride + j));
+		}
+		ops::store(result + j, mask, sum);
+	}
+}
+
+#endif
+
+/**
+ * Defines a kernel which adds |ROWS_PER_PASS| rows per pass, and the
+ * remaining rows in at most three more passes.
+ */
+#define DEFINE_ACCUMULATE(name, attributes)                                   \
+	template <class T, class A>                                                \
+	attributes void accumulate_##name(A* result, const T* data, size_t stride, \
+	                                  size_t rows, size_t length) {            \
+		for (; rows >= ROWS_PER_PASS; rows -= ROWS_PER_PASS) {                 \
+			add_rows_##name<T, A, ROWS_PER_PASS>(result, data, stride, length); \
+			data += ROWS_PER_PASS * stride;                                    \
+		}                                                                      \
+		if (rows & 4) {                                                        \
+			add_rows_##name<T, A, 4>(result, data, stride, length);            \
+			data += 4 * stride;                                                \
+		}                                                                      \
+		if (rows & 2) {                                                        \
+			add_rows_##name<T, A, 2>(result, data, stride, length);            \
+			data += 2 * stride;                                                \
+		}                                                                      \
+		if (rows & 1) {                                                        \
+			add_rows_##name<T, A, 1>(result, data, stride, length);            \
+		}                                                                      \
+	}
+
+DEFINE_ACCUMULATE(scalar, )
+
+#ifdef ACCUMULATE_X86
+DEFINE_ACCUMULATE(sse2, SSE2)
+DEFINE_ACCUMULATE(avx2, AVX2)
+DEFINE_ACCUMULATE(avx512, AVX512)
+
+#undef SSE2
+#undef AVX2
+#undef AVX512
+#endif
+
+#undef DEFINE_ACCUMULATE
+
+template <class T, class A>
+pfn_accumulate<T, A> best_kernel() {
+	for (int kind = static_cast<int>(accumulate_kind::count) - 1; kind >= 0;
+	     --kind) {
+		if (pfn_accumulate<T, A> kernel =
+		        accumulate_get<T, A>(static_cast<accumulate_kind>(kind))) {
+			return kernel;
+		}
+	}
+
+	return accumulate_scalar<T, A>;
+}
+
+}  // namespace
+
+template <class T, class A>
+void accumulate_rows(A* result, const T* data, size_t stride, size_t rows,
+                     size_t length) {
+	static const pfn_accumulate<T, A> kernel = best_kernel<T, A>();
+	kernel(result, data, stride, rows, length);
+}
+
+template <class T, class A>
+pfn_accumulate<T, A> accumulate_get(accumulate_kind kind) {
+	switch (kind) {
+		case accumulate_kind::scalar:
+			return accumulate_scalar<T, A>;
+#ifdef ACCUMULATE_X86
+		case accumulate_kind::sse2:
+			return __builtin_cpu_supports("sse2") ? accumulate_sse2<T, A> : nullptr;
+		case accumulate_kind::avx2:
+			return __builtin_cpu_supports("avx2") ? accumulate_avx2<T, A> : nullptr;
+		case accumulate_kind::avx512:
+			return __builtin_cpu_supports("avx512f") ? accumulate_avx512<T, A>
+			                                         : nullptr;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+#define INSTANTIATE_ACCUMULATE(T)                                            \
+	template void accumulate_rows(accumulator_t<T>* result, const T* data,    \
+	                              size_t stride, size_t rows, size_t length); \
+	template pfn_accumulate<T> accumulate_get<T>(accumulate_kind kind);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_ACCUMULATE)
+
+#undef INSTANTIATE_ACCUMULATE
+
+const char* accumulate_name(accumulate_kind kind) {
+	switch (kind) {
+		case accumulate_kind::scalar:
+			return "scalar";
+		case accumulate_kind::sse2:
+			return "sse2";
+		case accumulate_kind::avx2:
+			return "avx2";
+		case accumulate_kind::avx512:
+			return "avx512";
+		default:
+			return "unknown";
+	}
+}
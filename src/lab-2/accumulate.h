@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "element.h"
+
+enum class accumulate_kind {
+	scalar,
+	sse2,
+	avx2,
+	avx512,
+	count,
+};
+
+/**
+ * Adds |rows| rows of |length| elements to |result|. Row |i| starts at
+ * |data + i * stride|. Several rows are added in a single pass over |result|,
+ * so it's loaded and stored once per pass instead of once per row. Elements
+ * are widened to the accumulator type as they are loaded.
+ */
+template <class T, class A = accumulator_t<T>>
+using pfn_accumulate = void (*)(A* result, const T* data, size_t stride,
+                                size_t rows, size_t length);
+
+/**
+ * Same as |pfn_accumulate|; uses the fastest kernel the CPU supports. Defined
+ * for every element type with its accumulator type, which includes adding
+ * accumulators to each other.
+ */
+template <class T, class A>
+void accumulate_rows(A* result, const T* data, size_t stride, size_t rows,
+                     size_t length);
+
+/** Returns the given kernel, or nullptr if the CPU doesn't support it. */
+template <class T, class A = accumulator_t<T>>
+pfn_accumulate<T, A> accumulate_get(accumulate_kind kind);
+
+const char* accumulate_name(accumulate_kind kind);
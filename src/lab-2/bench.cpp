@@ -0,0 +1,166 @@
+#include "bench.h"
+
+#include <chrono>
+#include <format>
+#include <random>
+#include <vector>
+
+#include "accumulate.h"
+#include "matrix.h"
+#include "posix_buf.h"
+#include "thread_pool.h"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+namespace {
+
+/** Amount of elements in every benchmarked matrix: 64 MiB of longs. */
+constexpr size_t ELEMENTS = 8 * 1024 * 1024;
+
+/** Every measurement is repeated this many times, the best one is reported. */
+constexpr int REPEATS = 5;
+
+struct shape {
+	size_t rows;
+	size_t columns;
+};
+
+constexpr shape SHAPES[] = {
+    {2, ELEMENTS / 2},     {8, ELEMENTS / 8},       {64, ELEMENTS / 64},
+    {1024, ELEMENTS / 1024}, {16384, ELEMENTS / 16384}, {ELEMENTS / 6, 6},
+};
+
+/** The loop that row_split used before the kernels, for comparison. */
+template <class T, class A>
+void accumulate_row_by_row(A* result, const T* data, size_t stride,
+                           size_t rows, size_t length) {
+	for (size_t i = 0; i != rows; ++i) {
+		for (size_t j = 0; j != length; ++j) {
+			result[j] += data[i * stride + j];
+		}
+	}
+}
+
+/** Returns the best time of summing |arrays| with |kernel|, in seconds. */
+template <class T>
+double measure(pfn_accumulate<T> kernel, const matrix<T>& arrays,
+               const std::vector<accumulator_t<T>>& expected, bool& valid) {
+	double best = 0;
+	std::vector<accumulator_t<T>> result(arrays.columns());
+
+	for (int i = 0; i != REPEATS; ++i) {
+		std::fill(result.begin(), result.end(), 0);
+
+		auto start = steady_clock::now();
+		kernel(result.data(), arrays.data(), arrays.stride(), arrays.rows(),
+		       arrays.columns());
+		double seconds = duration<double>(steady_clock::now() - start).count();
+
+		if (i == 0 || seconds < best) best = seconds;
+	}
+
+	valid = result == expected;
+	return best;
+}
+
+void* empty_thread(void*) { return nullptr; }
+
+template <class T>
+int bench_element_type() {
+
+	std::mt19937_64 random(42);
+	std::uniform_int_distribution<long> numbers(-1000000, 1000000);
+	int status = 0;
+
+	const char* type = element_type_name(element_traits<T>::type);
+
+	for (auto [rows, columns] : SHAPES) {
+		matrix<T> arrays(rows, columns);
+		for (size_t i = 0; i != rows; ++i) {
+			for (T& item : arrays.row(i)) item = static_cast<T>(numbers(random));
+		}
+
+		std::vector<accumulator_t<T>> expected(columns);
+		accumulate_row_by_row(expected.data(), arrays.data(), arrays.stride(), rows,
+		                      columns);
+
+		double gib = static_cast<double>(rows * columns * sizeof(T)) /
+		             (1024.0 * 1024.0 * 1024.0);
+
+		for (int kind = -1; kind != static_cast<int>(accumulate_kind::count); ++kind) {
+			pfn_accumulate<T> kernel = accumulate_row_by_row;
+			const char* name = "row_by_row";
+
+			if (kind != -1) {
+				kernel = accumulate_get<T>(static_cast<accumulate_kind>(kind));
+				name = accumulate_name(static_cast<accumulate_kind>(kind));
+			}
+			if (!kernel) {
+				pout << std::format("type={} kernel={} supported=0\n", type, name);
+				continue;
+			}
+
+			bool valid;
+			double seconds = measure(kernel, arrays, expected, valid);
+			if (!valid) status = 1;
+
+			pout << std::format(
+			    "type={} kernel={} supported=1 valid={} k={} length={} seconds={} "
+			    "gib_per_s={}\n",
+			    type, name, valid ? 1 : 0, rows, columns, seconds, gib / seconds);
+		}
+	}
+
+	pout << std::flush;
+	return status;
+}
+
+}  // namespace
+
+int bench_accumulate() {
+	return bench_element_type<int32_t>() | bench_element_type<long>() |
+	       bench_element_type<float>() | bench_element_type<double>();
+}
+
+int bench_thread_pool() {
+	constexpr int LOOPS = 1000;
+
+	for (size_t threads : {2, 4, 8}) {
+		auto start = steady_clock::now();
+
+		for (int i = 0; i != LOOPS; ++i) {
+			pthread_t pthreads[8];
+			for (size_t j = 0; j != threads; ++j) {
+				if (pthread_create(&pthreads[j], nullptr, &empty_thread, nullptr)) {
+					throw std::runtime_error("can't create thread");
+				}
+			}
+			for (size_t j = 0; j != threads; ++j) {
+				pthread_join(pthreads[j], nullptr);
+			}
+		}
+
+		double createSeconds = duration<double>(steady_clock::now() - start).count();
+
+		// Start the workers before measuring.
+		std::atomic<size_t> calls = 0;
+		auto task = [&](size_t) { calls.fetch_add(1, std::memory_order_relaxed); };
+		thread_pool::shared().run(threads, task, threads);
+
+		start = steady_clock::now();
+		for (int i = 0; i != LOOPS; ++i) {
+			thread_pool::shared().run(threads, task, threads);
+		}
+
+		double poolSeconds = duration<double>(steady_clock::now() - start).count();
+		bool valid = calls == (LOOPS + 1) * threads;
+
+		pout << std::format(
+		    "threads={} valid={} pthread_create_us={} thread_pool_us={}\n", threads,
+		    valid ? 1 : 0, createSeconds / LOOPS * 1e6, poolSeconds / LOOPS * 1e6);
+	}
+
+	pout << std::flush;
+	return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+/**
+ * Compares accumulation kernels, and a plain one-row-per-pass loop, on
+ * matrices of several shapes and every element type. Prints one line per
+ * kernel, shape and type.
+ */
+int bench_accumulate();
+
+/**
+ * Compares the cost of starting a parallel loop on the shared thread pool with
+ * creating and joining pthreads for it.
+ */
+int bench_thread_pool();
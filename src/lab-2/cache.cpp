@@ -0,0 +1,46 @@
+#include "cache.h"
+
+#include <unistd.h>
+
+#include <format>
+#include <fstream>
+#include <string>
+
+namespace {
+
+/** Reads the size of the |index|-th cache of CPU 0 from sysfs, or 0. */
+size_t read_sysfs_cache_size(int index) {
+	std::ifstream file(std::format(
+	    "/sys/devices/system/cpu/cpu0/cache/index{}/size", index));
+
+	size_t size;
+	std::string unit;
+	if (!(file >> size)) return 0;
+
+	// Sizes look like "48K" or "2048K".
+	if (file >> unit) {
+		if (unit == "K") size *= 1024;
+		if (unit == "M") size *= 1024 * 1024;
+	}
+	return size;
+}
+
+size_t cache_size(int sysconfName, int sysfsIndex, size_t fallback) {
+	long size = sysconf(sysconfName);
+	if (size > 0) return static_cast<size_t>(size);
+
+	size_t sysfsSize = read_sysfs_cache_size(sysfsIndex);
+	return sysfsSize ? sysfsSize : fallback;
+}
+
+}  // namespace
+
+const cache_sizes& detect_cache_sizes() {
+	// sysfs lists L1d, L1i, L2 and L3 as index0..3 on x86.
+	static const cache_sizes sizes = {
+	    cache_size(_SC_LEVEL1_DCACHE_SIZE, 0, 32 * 1024),
+	    cache_size(_SC_LEVEL2_CACHE_SIZE, 2, 1024 * 1024),
+	    cache_size(_SC_LEVEL3_CACHE_SIZE, 3, 8 * 1024 * 1024),
+	};
+	return sizes;
+}
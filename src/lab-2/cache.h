@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+/** Data cache sizes of the CPU, in bytes. */
+struct cache_sizes {
+	size_t l1d;
+	size_t l2;
+	size_t l3;
+};
+
+/**
+ * Returns the cache sizes of the CPU the process started on. Sizes that can't
+ * be detected are replaced with typical ones.
+ */
+const cache_sizes& detect_cache_sizes();
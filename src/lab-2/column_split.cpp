@@ -1,74 +1,63 @@
 #include "column_split.h"
 
-#include <format>
+#include <algorithm>
 
-#include "posix_buf.h"
-
-using std::chrono::high_resolution_clock;
-using std::chrono::time_point;
+#include "accumulate.h"
+#include "thread_pool.h"
 
 namespace column_split {
 
-struct pthread_args {
-	const vector<vector<long>>& arrays;
+template <class T>
+struct task_args {
+	const matrix<T>& arrays;
 
-	vector<long>& result;
+	vector<accumulator_t<T>>& result;
 
 	size_t start;
 	size_t end;
 };
 
-void* pthread_func(void* argsPtr) {
-	auto args = static_cast<const pthread_args*>(argsPtr);
+template <class T>
+void task_func(void* argsPtr, size_t index) {
+	auto args = static_cast<const task_args<T>*>(argsPtr) + index;
 
-	for (size_t i = args->start; i != args->end; ++i) {
-		for (const vector<long>& array : args->arrays) {
-			args->result[i] += array[i];
-		}
-	}
+	const matrix<T>& arrays = args->arrays;
 
-	pthread_exit(nullptr);
+	// Walk the column range row by row, so that memory is read sequentially
+	// instead of one cache line per element.
+	accumulate_rows(args->result.data() + args->start, arrays.data() + args->start,
+	                arrays.stride(), arrays.rows(), args->end - args->start);
 }
 
-vector<long> sum(const vector<vector<long>>& arrays, size_t threads) {
-	size_t length = arrays[0].size();
+template <class T>
+vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads) {
+	size_t length = arrays.columns();
 
 	// Clamp threads to column amount.
 	threads = std::min(length, threads);
 
-	vector<long> result(length, 0);
-	vector<pthread_t> pthreads;
-	vector<pthread_args> args;
+	vector<accumulator_t<T>> result(length, 0);
+	vector<task_args<T>> args;
 
 	args.reserve(threads);
 
-	time_point timeStart = high_resolution_clock::now();
-
 	for (size_t i = 0; i != threads; ++i) {
 		size_t start = i * length / threads;
 		size_t end = (i + 1) * length / threads;
 
 		args.emplace_back(arrays, result, start, end);
-
-		pthread_t pthread;
-		if (pthread_create(&pthread, nullptr, &pthread_func, &args.back())) {
-			throw std::runtime_error("can't create thread");
-		}
-
-		pthreads.push_back(pthread);
 	}
 
-	for (pthread_t& thread : pthreads) {
-		pthread_join(thread, nullptr);
-	}
-
-	time_point timeEnd = high_resolution_clock::now();
-
-	auto ns = (timeEnd - timeStart).count();
-	auto ms = static_cast<double>(ns) / 1000000.0;
-	pout << std::format("Took {}ns ({}ms)\n", ns, ms);
+	thread_pool::shared().run(args.size(), &task_func<T>, args.data(), threads);
 
 	return result;
 }
 
+#define INSTANTIATE_SUM(T) \
+	template vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_SUM)
+
+#undef INSTANTIATE_SUM
+
 }  // namespace column_split
\ No newline at end of file
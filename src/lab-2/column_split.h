@@ -2,10 +2,14 @@
 
 #include <vector>
 
+#include "element.h"
+#include "matrix.h"
+
 using std::vector;
 
 namespace column_split {
 
-vector<long> sum(const vector<vector<long>>& arrays, size_t threads);
+template <class T>
+vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads);
 
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "element.h"
+
+namespace {
+
+constexpr element_type TYPES[] = {
+    element_type::int32,
+    element_type::int64,
+    element_type::float32,
+    element_type::float64,
+};
+
+}  // namespace
+
+const char* element_type_name(element_type type) {
+	switch (type) {
+		case element_type::int32:
+			return "int32";
+		case element_type::int64:
+			return "int64";
+		case element_type::float32:
+			return "float32";
+		case element_type::float64:
+			return "float64";
+		default:
+			return "unknown";
+	}
+}
+
+std::optional<element_type> element_type_from_name(std::string_view name) {
+	for (element_type type : TYPES) {
+		if (name == element_type_name(type)) {
+			return type;
+		}
+	}
+
+	return std::nullopt;
+}
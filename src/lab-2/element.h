@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+/** Type of matrix elements; the values are stored in matrix files. */
+enum class element_type : uint32_t {
+	int64 = 1,
+	int32 = 2,
+	float32 = 3,
+	float64 = 4,
+};
+
+/**
+ * Element type properties. Every type is summed into 64-bit accumulators:
+ * integers into longs, floats into doubles, so narrow elements are read at
+ * their own width but sums don't overflow or lose precision.
+ */
+template <class T>
+struct element_traits;
+
+template <>
+struct element_traits<int32_t> {
+	using accumulator = long;
+	static constexpr element_type type = element_type::int32;
+};
+
+template <>
+struct element_traits<long> {
+	using accumulator = long;
+	static constexpr element_type type = element_type::int64;
+};
+
+template <>
+struct element_traits<float> {
+	using accumulator = double;
+	static constexpr element_type type = element_type::float32;
+};
+
+template <>
+struct element_traits<double> {
+	using accumulator = double;
+	static constexpr element_type type = element_type::float64;
+};
+
+template <class T>
+using accumulator_t = typename element_traits<T>::accumulator;
+
+/** Expands |X(T)| for every element type, e.g. to instantiate templates. */
+#define FOR_EACH_ELEMENT_TYPE(X) X(int32_t) X(long) X(float) X(double)
+
+const char* element_type_name(element_type type);
+
+/** Returns the element type called |name|, if there is one. */
+std::optional<element_type> element_type_from_name(std::string_view name);
+
+/**
+ * Calls |func| with the std::type_identity of the C++ type of |type|, so that
+ * code templated on the element type can be picked at run time.
+ */
+template <class F>
+decltype(auto) visit_element_type(element_type type, F&& func) {
+	switch (type) {
+		case element_type::int32:
+			return func(std::type_identity<int32_t>());
+		case element_type::float32:
+			return func(std::type_identity<float>());
+		case element_type::float64:
+			return func(std::type_identity<double>());
+		default:
+			return func(std::type_identity<long>());
+	}
+}
@@ -1,24 +1,304 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <format>
+#include <iterator>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "column_split.h"
+#include "bench.h"
+#include "cache.h"
+#include "element.h"
+#include "matrix.h"
+#include "matrix_file.h"
+#include "parser.h"
+#include "placement.h"
 #include "posix_buf.h"
-#include "row_split.h"
+#include "strategy.h"
+#include "streaming.h"
+#include "thread_pool.h"
+#include "tuner.h"
 
+using std::chrono::high_resolution_clock;
+using std::chrono::time_point;
 using std::vector;
 
+/** Calibrates the profile for |k| x |length| inputs on synthetic data. */
+template <class T>
+static int tune_shape(size_t k, size_t length) {
+	// tune() measures on a sample anyway; don't allocate more than it uses.
+	size_t rowSize = std::max<size_t>(length, 1) * sizeof(T);
+	size_t rows = std::min(k, std::max<size_t>(32 * 1024 * 1024 / rowSize, 1));
+
+	matrix<T> sample(rows, length);
+	for (size_t i = 0; i != rows; ++i) {
+		std::span<T> row = sample.row(i);
+		for (size_t j = 0; j != length; ++j) {
+			row[j] = static_cast<T>((i * 31 + j) % 1000);
+		}
+	}
+
+	tuned_config config = tune(sample, k, length);
+	pout << std::format("  ==> {} with {} threads, saved to {}\n",
+	                    strategy_name(config.kind), config.threads, profile_path());
+
+	return 0;
+}
+
+/** Formats |result| first, so that it's written to stdout at once. */
+template <class A>
+static void print_result(const vector<A>& result) {
+	std::string output;
+	for (A item : result) {
+		std::format_to(std::back_inserter(output), "{} ", item);
+	}
+	pout << output;
+}
+
+/** Sums |k| arrays of text from stdin while they are being read. */
+template <class T>
+static int stream(size_t k, size_t threads) {
+	pout << "  ==> streaming with "
+	     << (threads ? std::to_string(threads) : "one per CPU") << " threads"
+	     << std::endl;
+
+	time_point timeStart = high_resolution_clock::now();
+
+	std::optional<vector<accumulator_t<T>>> result;
+	try {
+		result = streaming::sum<T>(STDIN_FILENO, k, threads);
+	} catch (const std::runtime_error& error) {
+		perr << "Can't stream input: " << error.what() << std::endl;
+		return 1;
+	}
+
+	if (!result) {
+		perr << "Arrays have different lengths :/ "
+		        "Perhaps you supplied an incorrect `k`"
+		     << std::endl;
+		return 1;
+	}
+
+	time_point timeEnd = high_resolution_clock::now();
+
+	// Includes reading and parsing, which the summation overlaps.
+	auto ns = (timeEnd - timeStart).count();
+	auto ms = static_cast<double>(ns) / 1000000.0;
+	pout << std::format("Took {}ns ({}ms)\n", ns, ms);
+
+	print_result(*result);
+	return 0;
+}
+
+/**
+ * Reads |k| arrays from |input|, either a matrix file or text, placed for
+ * summing with |threads| threads. Prints an error and returns false if the
+ * input is invalid.
+ */
+template <class T>
+static bool read_input(const input_text& input, size_t k, size_t threads,
+                       matrix<T>& arrays) {
+	if (is_matrix_file(input.text())) {
+		// Only a mapping can be used in place; a matrix file is rarely piped.
+		if (!input.mapped()) {
+			perr << "A matrix file must be redirected from a file, not piped"
+			     << std::endl;
+			return false;
+		}
+
+		try {
+			arrays = map_matrix_file<T>(input.text(), input.storage());
+		} catch (const std::runtime_error& error) {
+			perr << "Invalid matrix file: " << error.what() << std::endl;
+			return false;
+		}
+
+		if (arrays.rows() != k) {
+			perr << std::format("The matrix file has {} arrays, not {}\n",
+			                    arrays.rows(), k);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Parse the text in place: rows are cut at newlines and then parsed in
+	// parallel straight into the matrix.
+	if (!parse_matrix(split_lines(input.text(), k), arrays, threads)) {
+		perr << "Arrays have different lengths :/ "
+		        "Perhaps you supplied an incorrect `k`"
+		     << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/** Converts |k| arrays of text from |input| into the matrix file |path|. */
+template <class T>
+static int convert(const input_text& input, size_t k, const char* path) {
+	matrix<T> arrays;
+	if (!read_input(input, k, 1, arrays)) {
+		return 1;
+	}
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		perr << std::format("Can't open {}: {}\n", path, std::strerror(errno));
+		return 1;
+	}
+
+	bool written = write_matrix_file(fd, arrays);
+	if (close(fd) == -1) {
+		written = false;
+	}
+
+	if (!written) {
+		perr << std::format("Can't write {}: {}\n", path, std::strerror(errno));
+		return 1;
+	}
+
+	pout << std::format("Wrote {} x {} {} matrix to {}\n", arrays.rows(),
+	                    arrays.columns(),
+	                    element_type_name(element_traits<T>::type), path);
+	return 0;
+}
+
+/** Sums |k| arrays from |input| with |threads| threads, or tuned ones if 0. */
+template <class T>
+static int sum_input(const input_text& input, size_t k, size_t threads) {
+	// Tuning picks the thread count later; expect all CPUs until then.
+	matrix<T> arrays;
+	if (!read_input(input, k, threads, arrays)) {
+		return 1;
+	}
+
+	double rowsToColumns =
+	    static_cast<double>(arrays.rows()) / static_cast<double>(arrays.columns());
+	pout << "row / column ratio: " << rowsToColumns << ", L2 cache: "
+	     << detect_cache_sizes().l2 / 1024 << " KiB" << std::endl;
+
+	strategy kind;
+	if (threads == 0) {
+		std::optional<tuned_config> config = profile_lookup(
+		    element_traits<T>::type, arrays.rows(), arrays.columns());
+		if (!config) {
+			pout << "No tuning profile entry for this shape" << std::endl;
+			config = tune(arrays, arrays.rows(), arrays.columns());
+		}
+
+		kind = config->kind;
+		threads = config->threads;
+		pout << "  ==> using " << strategy_name(kind) << " with " << threads
+		     << " threads (tuned)" << std::endl;
+	} else {
+		kind = choose_strategy(arrays.rows(), arrays.columns(), threads);
+		pout << "  ==> using " << strategy_name(kind) << std::endl;
+	}
+
+	time_point timeStart = high_resolution_clock::now();
+
+	vector<accumulator_t<T>> result = sum(kind, arrays, threads);
+
+	time_point timeEnd = high_resolution_clock::now();
+
+	auto ns = (timeEnd - timeStart).count();
+	auto ms = static_cast<double>(ns) / 1000000.0;
+	pout << std::format("Took {}ns ({}ms)\n", ns, ms);
+
+	print_result(result);
+
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
+	const char* program = argv[0];
+
+	std::optional<element_type> requestedType;
+	bool pin = false;
+	while (argc >= 2) {
+		std::string_view option = argv[1];
+
+		if (option == "--type" && argc >= 3) {
+			requestedType = element_type_from_name(argv[2]);
+			if (!requestedType) {
+				perr << std::format("Unknown element type `{}`\n", argv[2]);
+				return 1;
+			}
+
+			argc -= 2;
+			argv += 2;
+		} else if (option == "--pin") {
+			pin = true;
+
+			--argc;
+			++argv;
+		} else {
+			break;
+		}
+	}
+
+	if (pin) {
+		std::vector<int> cpus = cpus_by_node();
+		thread_pool::shared().pin(cpus);
+		pout << std::format("Pinning threads to {} CPUs on {} NUMA nodes\n",
+		                    cpus.size(), count_nodes(cpus));
+	}
+
+	if (argc == 2 && std::string_view(argv[1]) == "--bench") {
+		return bench_accumulate() | bench_thread_pool();
+	}
+
+	bool tuneOnly = argc == 4 && std::string_view(argv[1]) == "--tune";
+	bool convertOnly = argc == 4 && std::string_view(argv[1]) == "--convert";
+	bool streamOnly = argc == 4 && std::string_view(argv[1]) == "--stream";
+	if (tuneOnly || convertOnly || streamOnly) {
+		--argc;
+		++argv;
+	}
+
 	if (argc != 3) {
 		perr << std::format(
-		    "usage: {} <k> <threads>\n"
+		    "usage: {} [--type <type>] [--pin] <k> <threads>\n"
+		    "       {} [--type <type>] [--pin] --stream <k> <threads>\n"
+		    "       {} [--type <type>] [--pin] --tune <k> <length>\n"
+		    "       {} [--type <type>] --convert <k> <file>\n"
+		    "       {} --bench\n"
 		    "\n"
 		    "Sums array columns using multiple threads.\n"
 		    "\n"
 		    "  <k>       -- number of arrays\n"
-		    "  <threads> -- number of threads\n",
-		    argv[0]);
+		    "  <threads> -- number of threads; 0 uses the tuning profile, which\n"
+		    "               is calibrated on the input if it has no entry for\n"
+		    "               its shape\n"
+		    "  --type    -- element type: int32, int64, float32 or float64;\n"
+		    "               integers are summed as int64, floats as float64.\n"
+		    "               Defaults to the type of a matrix file, or int64\n"
+		    "  --pin     -- pin threads to CPUs, filling one NUMA node after\n"
+		    "               another\n"
+		    "\n"
+		    "The input is either text or a matrix file, which is mapped and\n"
+		    "summed in place; it must be redirected from a file then. Text is\n"
+		    "parsed so that rows are on the NUMA node of the thread summing them.\n"
+		    "\n"
+		    "  --stream  -- sum text arrays while they are read, in memory\n"
+		    "               proportional to `threads` instead of `k`; 0\n"
+		    "               threads means one per CPU\n"
+		    "  --tune    -- calibrate the profile for `k` arrays of `length`\n"
+		    "               numbers on synthetic data\n"
+		    "  --convert -- convert `k` arrays of text from stdin into the\n"
+		    "               matrix file `file`\n"
+		    "  --bench   -- compare accumulation kernels on several shapes and\n"
+		    "               thread start-up costs\n",
+		    program, program, program, program, program);
 		return 1;
 	}
 
@@ -31,59 +311,47 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	size_t threads;
-	{
+	size_t threads = 0;
+	if (!convertOnly) {
 		std::istringstream stream(argv[2]);
 		if (!(stream >> threads)) {
-			perr << "Invalid `threads`; malformed number\n";
+			perr << std::format("Invalid `{}`; malformed number\n",
+			                    tuneOnly ? "length" : "threads");
 			return 1;
 		}
 	}
 
-	pout << "Input `k` number arrays with the same lengths; "
-	        "one array per line, numbers are separated with spaces"
-	     << std::endl;
-
-	vector<vector<long>> arrays(k);
-
-	for (size_t i = 0; i != k; ++i) {
-		std::string line;
-		std::getline(pin, line);
+	element_type type = requestedType.value_or(element_type::int64);
 
-		std::istringstream stream(line);
-		long number;
-
-		while (stream >> number) {
-			arrays[i].push_back(number);
-		}
+	if (tuneOnly) {
+		return visit_element_type(type, [&](auto tag) {
+			return tune_shape<typename decltype(tag)::type>(k, threads);
+		});
 	}
 
-	for (size_t i = 1; i != k; ++i) {
-		if (arrays[i].size() != arrays[i - 1].size()) {
-			perr << "Arrays have different lengths :/ "
-			        "Perhaps you supplied an incorrect `k`"
-			     << std::endl;
-			return 1;
-		}
+	if (!convertOnly) {
+		pout << "Input `k` number arrays with the same lengths; "
+		        "one array per line, numbers are separated with spaces"
+		     << std::endl;
 	}
 
-	vector<long> result;
-
-	double rowsToColumns =
-	    static_cast<double>(arrays.size()) / static_cast<double>(arrays[0].size());
-	pout << "row / column ratio: " << rowsToColumns << std::endl;
-
-	if (rowsToColumns > 2.0) {
-		pout << "  ==> using row_split" << std::endl;
-		result = row_split::sum(arrays, threads);
-	} else {
-		pout << "  ==> using column_split" << std::endl;
-		result = column_split::sum(arrays, threads);
+	if (streamOnly) {
+		return visit_element_type(type, [&](auto tag) {
+			return stream<typename decltype(tag)::type>(k, threads);
+		});
 	}
 
-	for (long item : result) {
-		pout << item << " ";
+	input_text input(STDIN_FILENO, k);
+
+	// A matrix file knows its type; a conflicting --type is reported when
+	// it's mapped.
+	if (!requestedType) {
+		type = matrix_file_type(input.text()).value_or(type);
 	}
 
-	return 0;
-}
\ No newline at end of file
+	return visit_element_type(type, [&](auto tag) {
+		using T = typename decltype(tag)::type;
+		return convertOnly ? convert<T>(input, k, argv[2])
+		                   : sum_input<T>(input, k, threads);
+	});
+}
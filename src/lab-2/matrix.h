@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+/** Size of a cache line; every row starts at a multiple of it. */
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+/** Column of a row-major matrix: every |stride|-th element of |data|. */
+template <class T>
+class column_view {
+	const T* data_;
+	size_t stride_;
+	size_t size_;
+
+   public:
+	column_view(const T* data, size_t stride, size_t size)
+	    : data_(data), stride_(stride), size_(size) {}
+
+	size_t size() const { return size_; }
+
+	const T& operator[](size_t i) const { return data_[i * stride_]; }
+};
+
+/**
+ * Row-major matrix of |T| in a single cache-line-aligned allocation. Rows
+ * are padded to |stride()| elements, so each of them starts at a cache line
+ * too.
+ *
+ * A matrix can also wrap rows that live in other memory, e.g. a mapped file.
+ */
+template <class T>
+class matrix {
+	size_t rows_;
+	size_t columns_;
+	/** Distance between the starts of adjacent rows, in elements. */
+	size_t stride_;
+	T* data_;
+	/** Keeps the memory behind |data_| alive. */
+	std::shared_ptr<const void> storage_;
+
+   public:
+	matrix() : rows_(0), columns_(0), stride_(0), data_(nullptr) {}
+
+	/** Allocates a matrix with zero-initialized elements. */
+	matrix(size_t rows, size_t columns) : matrix(uninitialized(rows, columns)) {
+		std::fill_n(data_, rows_ * stride_, T());
+	}
+
+	/**
+	 * Returns a matrix whose memory isn't touched yet, so that every page
+	 * lands on the NUMA node of the thread that writes it first. The caller
+	 * must write the padding too.
+	 */
+	static matrix uninitialized(size_t rows, size_t columns) {
+		constexpr size_t perLine = CACHE_LINE_SIZE / sizeof(T);
+		size_t stride = (columns + perLine - 1) / perLine * perLine;
+
+		// aligned_alloc() needs a non-zero size that is a multiple of the
+		// alignment; the stride makes it one.
+		size_t size = std::max<size_t>(rows * stride, perLine) * sizeof(T);
+
+		auto data = static_cast<T*>(std::aligned_alloc(CACHE_LINE_SIZE, size));
+		if (!data) {
+			throw std::bad_alloc();
+		}
+
+		return matrix(rows, columns, stride, data,
+		              std::shared_ptr<const void>(data, std::free));
+	}
+
+	/**
+	 * Wraps |rows| rows of |columns| elements at |data|, |stride| elements
+	 * apart. |storage| owns the memory; the matrix keeps it alive.
+	 */
+	matrix(size_t rows, size_t columns, size_t stride, T* data,
+	       std::shared_ptr<const void> storage)
+	    : rows_(rows),
+	      columns_(columns),
+	      stride_(stride),
+	      data_(data),
+	      storage_(std::move(storage)) {}
+
+	// copying this shouldn't be possible
+	matrix(const matrix&) = delete;
+	matrix& operator=(const matrix&) = delete;
+
+	matrix(matrix&& other) noexcept
+	    : rows_(std::exchange(other.rows_, 0)),
+	      columns_(std::exchange(other.columns_, 0)),
+	      stride_(std::exchange(other.stride_, 0)),
+	      data_(std::exchange(other.data_, nullptr)),
+	      storage_(std::move(other.storage_)) {}
+
+	matrix& operator=(matrix&& other) noexcept {
+		rows_ = std::exchange(other.rows_, 0);
+		columns_ = std::exchange(other.columns_, 0);
+		stride_ = std::exchange(other.stride_, 0);
+		data_ = std::exchange(other.data_, nullptr);
+		storage_ = std::move(other.storage_);
+		return *this;
+	}
+
+	size_t rows() const { return rows_; }
+
+	size_t columns() const { return columns_; }
+
+	size_t stride() const { return stride_; }
+
+	T* data() { return data_; }
+
+	const T* data() const { return data_; }
+
+	std::span<T> row(size_t i) { return {data_ + i * stride_, columns_}; }
+
+	std::span<const T> row(size_t i) const {
+		return {data_ + i * stride_, columns_};
+	}
+
+	column_view<T> column(size_t j) const { return {data_ + j, stride_, rows_}; }
+
+	T& operator()(size_t i, size_t j) { return data_[i * stride_ + j]; }
+
+	T operator()(size_t i, size_t j) const { return data_[i * stride_ + j]; }
+};
@@ -0,0 +1,120 @@
+#include "matrix_file.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr char MAGIC[8] = {'L', 'A', 'B', '2', 'M', 'A', 'T', '\n'};
+
+constexpr uint32_t VERSION = 1;
+
+/**
+ * Alignment of the data within the file. A page, so that a mapping of the
+ * whole file puts every row at a cache line.
+ */
+constexpr size_t DATA_ALIGNMENT = 4096;
+
+bool write_all(int fd, const char* data, size_t size) {
+	while (size != 0) {
+		ssize_t nWritten = write(fd, data, size);
+		if (nWritten == -1) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+
+		data += nWritten;
+		size -= static_cast<size_t>(nWritten);
+	}
+
+	return true;
+}
+
+}  // namespace
+
+bool is_matrix_file(std::string_view bytes) {
+	return bytes.size() >= sizeof(MAGIC) &&
+	       std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::optional<element_type> matrix_file_type(std::string_view bytes) {
+	matrix_file_header header;
+	if (bytes.size() < sizeof(header) || !is_matrix_file(bytes)) {
+		return std::nullopt;
+	}
+
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	return header.elementType;
+}
+
+template <class T>
+bool write_matrix_file(int fd, const matrix<T>& arrays) {
+	matrix_file_header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.elementType = element_traits<T>::type;
+	header.rows = arrays.rows();
+	header.columns = arrays.columns();
+	header.stride = arrays.stride();
+	header.dataOffset = DATA_ALIGNMENT;
+
+	// The header padded up to the data.
+	std::vector<char> prefix(header.dataOffset, 0);
+	std::memcpy(prefix.data(), &header, sizeof(header));
+
+	return write_all(fd, prefix.data(), prefix.size()) &&
+	       write_all(fd, reinterpret_cast<const char*>(arrays.data()),
+	                 arrays.rows() * arrays.stride() * sizeof(T));
+}
+
+template <class T>
+matrix<T> map_matrix_file(std::string_view bytes,
+                          std::shared_ptr<const void> storage) {
+	matrix_file_header header;
+	if (bytes.size() < sizeof(header) || !is_matrix_file(bytes)) {
+		throw std::runtime_error("not a matrix file");
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+
+	if (header.version != VERSION) {
+		throw std::runtime_error("unsupported matrix file version");
+	}
+	if (header.elementType != element_traits<T>::type) {
+		throw std::runtime_error(
+		    std::format("the matrix file holds {} elements, not {}",
+		                element_type_name(header.elementType),
+		                element_type_name(element_traits<T>::type)));
+	}
+	if (header.stride < header.columns || header.dataOffset < sizeof(header) ||
+	    header.dataOffset > bytes.size()) {
+		throw std::runtime_error("malformed matrix file header");
+	}
+
+	size_t available = (bytes.size() - header.dataOffset) / sizeof(T);
+	if (header.stride != 0 && header.rows > available / header.stride) {
+		throw std::runtime_error("matrix file is truncated");
+	}
+
+	const char* data = bytes.data() + header.dataOffset;
+	if (reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+		throw std::runtime_error("matrix file data isn't aligned");
+	}
+
+	return matrix<T>(header.rows, header.columns, header.stride,
+	                 reinterpret_cast<T*>(const_cast<char*>(data)),
+	                 std::move(storage));
+}
+
+#define INSTANTIATE_MATRIX_FILE(T)                                  \
+	template bool write_matrix_file(int fd, const matrix<T>& arrays); \
+	template matrix<T> map_matrix_file(std::string_view bytes,       \
+	                                   std::shared_ptr<const void> storage);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_MATRIX_FILE)
+
+#undef INSTANTIATE_MATRIX_FILE
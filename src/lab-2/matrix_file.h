@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "element.h"
+#include "matrix.h"
+
+/**
+ * Header at the start of a binary matrix file. All fields are in the byte
+ * order of the machine that wrote the file. The rows follow at |dataOffset|,
+ * |stride| elements apart; the padding between them is zeroed.
+ */
+struct matrix_file_header {
+	char magic[8];
+	uint32_t version;
+	element_type elementType;
+	uint64_t rows;
+	uint64_t columns;
+	uint64_t stride;
+	uint64_t dataOffset;
+};
+
+/** Returns whether |bytes| start with the magic of a matrix file. */
+bool is_matrix_file(std::string_view bytes);
+
+/**
+ * Returns the element type of the matrix file in |bytes|, or nothing if it
+ * isn't one.
+ */
+std::optional<element_type> matrix_file_type(std::string_view bytes);
+
+/**
+ * Writes |arrays| to |fd| as a matrix file. Returns false on write errors,
+ * with errno set.
+ */
+template <class T>
+bool write_matrix_file(int fd, const matrix<T>& arrays);
+
+/**
+ * Wraps the rows of the matrix file in |bytes| without copying them; the
+ * matrix keeps |storage|, which owns |bytes|, alive. The bytes must be
+ * writable if the matrix is written to. Throws std::runtime_error if the file
+ * is malformed, holds elements of another type than |T|, or its data isn't
+ * aligned in memory.
+ */
+template <class T>
+matrix<T> map_matrix_file(std::string_view bytes,
+                          std::shared_ptr<const void> storage);
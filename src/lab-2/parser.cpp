@@ -0,0 +1,182 @@
+#include "parser.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include "placement.h"
+#include "posix_buf.h"
+#include "thread_pool.h"
+
+namespace {
+
+/** Size of a single read() from a pipe or a terminal. */
+constexpr size_t READ_SIZE = 1024 * 1024;
+
+/** Amount of lines parsed by a single pool task. */
+constexpr size_t LINES_PER_TASK = 64;
+
+/** Amount of lines with a wrong length that are reported. */
+constexpr size_t MAX_REPORTED_LINES = 10;
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+}  // namespace
+
+input_text::input_text(int fd, size_t lines) : mapped_(false) {
+	struct stat st;
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset != -1 &&
+	    offset < st.st_size) {
+		auto size = static_cast<size_t>(st.st_size);
+
+		// Writable, so that binary matrices can be used in place; pages are
+		// only copied if they are written to.
+		void* data =
+		    mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, size, MADV_WILLNEED);
+
+			storage_ = std::shared_ptr<char>(static_cast<char*>(data),
+			                                 [size](char* p) { munmap(p, size); });
+			mapped_ = true;
+			text_ = std::string_view(storage_.get() + offset, size - offset);
+			return;
+		}
+	}
+
+	// Read until the requested lines are in, so a terminal or a pipe which
+	// stays open isn't waited on.
+	auto buffer = std::make_shared<std::vector<char>>();
+	size_t newlines = 0;
+	size_t used = 0;
+
+	while (newlines < lines) {
+		buffer->resize(used + READ_SIZE);
+
+		ssize_t nRead = read(fd, buffer->data() + used, READ_SIZE);
+		if (nRead == -1) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("can't read input");
+		}
+		if (nRead == 0) break;
+
+		newlines += std::count(buffer->data() + used, buffer->data() + used + nRead,
+		                       '\n');
+		used += static_cast<size_t>(nRead);
+	}
+
+	buffer->resize(used);
+	storage_ = std::shared_ptr<char>(buffer, buffer->data());
+	text_ = std::string_view(storage_.get(), used);
+}
+
+std::vector<std::string_view> split_lines(std::string_view text, size_t count) {
+	std::vector<std::string_view> lines;
+	lines.reserve(count);
+
+	const char* position = text.data();
+	const char* end = text.data() + text.size();
+
+	while (lines.size() != count && position != end) {
+		auto newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+		const char* lineEnd = newline ? newline : end;
+
+		lines.emplace_back(position, lineEnd - position);
+		position = newline ? newline + 1 : end;
+	}
+
+	lines.resize(count);
+	return lines;
+}
+
+template <class T>
+size_t parse_row(std::string_view line, std::span<T> row) {
+	const char* position = line.data();
+	const char* end = line.data() + line.size();
+	size_t count = 0;
+
+	while (true) {
+		while (position != end && is_space(*position)) ++position;
+		if (position == end) break;
+
+		// from_chars() doesn't accept a plus sign, unlike operator>>.
+		if (*position == '+' && end - position > 1 && position[1] != '-') {
+			++position;
+		}
+
+		T number;
+		auto [next, error] = std::from_chars(position, end, number);
+		if (error != std::errc()) break;
+
+		if (count < row.size()) row[count] = number;
+		++count;
+
+		position = next;
+	}
+
+	return count;
+}
+
+template <class T>
+bool parse_matrix(const std::vector<std::string_view>& lines, matrix<T>& arrays,
+                  size_t threads) {
+	if (lines.empty()) {
+		arrays = matrix<T>();
+		return true;
+	}
+
+	// Parse the first line twice: once to count numbers, once into the row.
+	size_t length = parse_row<T>(lines[0], {});
+	arrays = matrix<T>::uninitialized(lines.size(), length);
+	first_touch(arrays, threads);
+	parse_row(lines[0], arrays.row(0));
+
+	std::atomic<bool> valid = true;
+	std::atomic<size_t> reported = 0;
+	size_t tasks = (lines.size() - 1 + LINES_PER_TASK - 1) / LINES_PER_TASK;
+
+	thread_pool::shared().run(
+	    tasks,
+	    [&](size_t task) {
+		    size_t start = 1 + task * LINES_PER_TASK;
+		    size_t end = std::min(start + LINES_PER_TASK, lines.size());
+
+		    for (size_t i = start; i != end; ++i) {
+			    size_t count = parse_row(lines[i], arrays.row(i));
+			    if (count == length) continue;
+
+			    valid.store(false, std::memory_order_relaxed);
+			    if (reported.fetch_add(1, std::memory_order_relaxed) <
+			        MAX_REPORTED_LINES) {
+				    // Pool threads report on their own, without a lock.
+				    terr << std::format("Array {} has {} numbers instead of {}", i + 1,
+				                        count, length)
+				         << std::endl;
+			    }
+		    }
+	    },
+	    threads);
+
+	return valid;
+}
+
+#define INSTANTIATE_PARSER(T)                                              \
+	template size_t parse_row(std::string_view line, std::span<T> row);     \
+	template bool parse_matrix(const std::vector<std::string_view>& lines, \
+	                           matrix<T>& arrays, size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_PARSER)
+
+#undef INSTANTIATE_PARSER
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "element.h"
+#include "matrix.h"
+
+/**
+ * Text read from a file descriptor: mapped if it's a regular file, otherwise
+ * read into memory.
+ */
+class input_text {
+	/** Mapping or buffer that |text_| points into. */
+	std::shared_ptr<char> storage_;
+	bool mapped_;
+	std::string_view text_;
+
+   public:
+	/**
+	 * Maps |fd| from its current offset, or reads it until |lines| newlines
+	 * were read or EOF. Throws std::runtime_error on read errors.
+	 */
+	input_text(int fd, size_t lines);
+
+	std::string_view text() const { return text_; }
+
+	/** Returns whether the text is a private, writable mapping of a file. */
+	bool mapped() const { return mapped_; }
+
+	/** Returns the owner of the memory |text()| points into. */
+	const std::shared_ptr<char>& storage() const { return storage_; }
+};
+
+/**
+ * Splits the first |count| lines off |text|, without line separators. Missing
+ * lines are returned empty.
+ */
+std::vector<std::string_view> split_lines(std::string_view text, size_t count);
+
+/**
+ * Parses whitespace-separated numbers from |line| into |row|, up to the first
+ * malformed one or one that doesn't fit into |T|. Returns the amount of
+ * numbers found; if it's more than |row.size()|, the extra ones aren't stored.
+ */
+template <class T>
+size_t parse_row(std::string_view line, std::span<T> row);
+
+/**
+ * Parses |lines| into a matrix with one row per line. The first line gives
+ * the length; the other lines are parsed on |threads| threads (0 means one per
+ * CPU) straight into their rows. Rows are first touched as row_split with
+ * |threads| threads reads them (see first_touch()). Returns false if lines
+ * have different lengths, and reports the first few of them to |terr|.
+ */
+template <class T>
+bool parse_matrix(const std::vector<std::string_view>& lines, matrix<T>& arrays,
+                  size_t threads);
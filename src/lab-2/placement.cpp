@@ -0,0 +1,122 @@
+#include "placement.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "element.h"
+#include "thread_pool.h"
+
+namespace {
+
+/** Highest NUMA node looked for in sysfs. */
+constexpr int MAX_NODES = 64;
+
+/** Parses a sysfs CPU list like "0-3,8-11" into the CPUs it lists. */
+std::vector<int> parse_cpu_list(const std::string& list) {
+	std::vector<int> cpus;
+	std::istringstream stream(list);
+	std::string range;
+
+	while (std::getline(stream, range, ',')) {
+		int first;
+		int last;
+		char dash;
+
+		std::istringstream rangeStream(range);
+		if (!(rangeStream >> first)) continue;
+		if (!(rangeStream >> dash >> last)) last = first;
+
+		for (int cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
+
+/** Returns the CPUs of NUMA node |node|; empty if there's no such node. */
+std::vector<int> node_cpus(int node) {
+	std::ifstream file(
+	    std::format("/sys/devices/system/node/node{}/cpulist", node));
+
+	std::string list;
+	if (!std::getline(file, list)) return {};
+
+	return parse_cpu_list(list);
+}
+
+}  // namespace
+
+std::vector<int> cpus_by_node() {
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		return {};
+	}
+
+	std::vector<int> cpus;
+	for (int node = 0; node != MAX_NODES; ++node) {
+		for (int cpu : node_cpus(node)) {
+			if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+				cpus.push_back(cpu);
+				CPU_CLR(cpu, &allowed);
+			}
+		}
+	}
+
+	// CPUs of no known node, or all of them if there's no topology.
+	for (int cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &allowed)) {
+			cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
+
+size_t count_nodes(const std::vector<int>& cpus) {
+	size_t count = 0;
+
+	for (int node = 0; node != MAX_NODES; ++node) {
+		std::vector<int> nodeCpus = node_cpus(node);
+		if (std::ranges::any_of(nodeCpus, [&](int cpu) {
+			    return std::ranges::find(cpus, cpu) != cpus.end();
+		    })) {
+			++count;
+		}
+	}
+
+	return std::max<size_t>(count, 1);
+}
+
+template <class T>
+void first_touch(matrix<T>& arrays, size_t threads) {
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+	}
+
+	size_t height = arrays.rows();
+	size_t bands = std::min(height, threads);
+	if (bands == 0) return;
+
+	thread_pool::shared().run_on_each(bands, [&](size_t band) {
+		size_t start = band * height / bands;
+		size_t end = (band + 1) * height / bands;
+
+		std::fill_n(arrays.row(start).data(), (end - start) * arrays.stride(),
+		            T());
+	});
+}
+
+#define INSTANTIATE_FIRST_TOUCH(T) \
+	template void first_touch(matrix<T>& arrays, size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_FIRST_TOUCH)
+
+#undef INSTANTIATE_FIRST_TOUCH
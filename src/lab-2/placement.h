@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "matrix.h"
+
+/**
+ * Returns the CPUs this process may run on, grouped by NUMA node, so that
+ * adjacent pool participants share a node. Falls back to a single node if
+ * the topology can't be read.
+ */
+std::vector<int> cpus_by_node();
+
+/** Returns the amount of NUMA nodes which have any of |cpus|. */
+size_t count_nodes(const std::vector<int>& cpus);
+
+/**
+ * Zeroes the rows of |arrays| in the same bands that row_split sums with
+ * |threads| threads (0 means one per CPU), each on the pool participant
+ * that sums it. Applied to an uninitialized matrix, this places every band
+ * on the NUMA node of the thread that reads it.
+ */
+template <class T>
+void first_touch(matrix<T>& arrays, size_t threads);
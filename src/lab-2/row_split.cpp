@@ -1,96 +1,126 @@
 #include "row_split.h"
 
-#include <format>
+#include <algorithm>
+#include <mutex>
 
-#include "posix_buf.h"
-
-using std::chrono::high_resolution_clock;
-using std::chrono::time_point;
+#include "accumulate.h"
+#include "thread_pool.h"
 
 namespace row_split {
 
-struct pthread_args {
-	const vector<vector<long>>& arrays;
+/** Least amount of columns merged by one task; narrower merges stay serial. */
+constexpr size_t MERGE_COLUMNS = 4096;
+
+/**
+ * Partial sums of the bands, one row per band. Kept between calls, so they're
+ * allocated once and only grow; row |i| is first touched by the participant
+ * that sums band |i|, so it stays on that thread's NUMA node.
+ */
+template <class A>
+struct partial_sums {
+	std::mutex mutex;
+	matrix<A> rows;
+};
+
+template <class A>
+partial_sums<A>& shared_partials() {
+	static partial_sums<A> partials;
+	return partials;
+}
+
+template <class T>
+struct task_args {
+	const matrix<T>& arrays;
 
-	/** Owned vector with temporary result for the row.*/
-	vector<long> result;
+	/** Row of shared_partials() which receives the band's sums. */
+	accumulator_t<T>* result;
 
 	size_t start;
 	size_t end;
 };
 
-void* pthread_func(void* argsPtr) {
-	auto args = static_cast<pthread_args*>(argsPtr);
-	// Length is the same for all arrays.
-	size_t length = args->arrays[0].size();
-
-	for (size_t i = args->start; i != args->end; ++i) {
-		for (size_t j = 0; j != length; ++j) {
-			args->result[j] += args->arrays[i][j];
-		}
-	}
+template <class T>
+void task_func(void* argsPtr, size_t index) {
+	auto args = static_cast<task_args<T>*>(argsPtr) + index;
+	const matrix<T>& arrays = args->arrays;
 
-	pthread_exit(argsPtr);
+	std::fill_n(args->result, arrays.columns(), 0);
+	accumulate_rows(args->result, arrays.row(args->start).data(),
+	                arrays.stride(), args->end - args->start, arrays.columns());
 }
 
-vector<long> sum(const vector<vector<long>>& arrays, size_t threads) {
-	size_t length = arrays[0].size();
-	size_t height = arrays.size();
+template <class T>
+vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads) {
+	using A = accumulator_t<T>;
+
+	size_t length = arrays.columns();
+	size_t height = arrays.rows();
 
 	// Clamp threads to row amount.
 	threads = std::min(height, threads);
 
-	vector<long> result(length, 0);
-	vector<pthread_t> pthreads;
-	vector<pthread_args> args;
+	vector<A> result(length, 0);
 
-	// Reserve capacity for all threads, so that the vector isn't reallocated.
-	args.reserve(threads);
+	// A single band needs no partial sums.
+	if (threads <= 1) {
+		if (height != 0) {
+			accumulate_rows(result.data(), arrays.data(), arrays.stride(), height,
+			                length);
+		}
+		return result;
+	}
 
-	time_point timeStart = high_resolution_clock::now();
+	partial_sums<A>& partials = shared_partials<A>();
+	std::lock_guard lock(partials.mutex);
 
-	for (size_t i = 0; i != threads; ++i) {
-		size_t start = i * height / threads;
-		size_t end = (i + 1) * height / threads;
+	if (partials.rows.rows() < threads || partials.rows.columns() < length) {
+		partials.rows = matrix<A>::uninitialized(
+		    std::max(partials.rows.rows(), threads),
+		    std::max(partials.rows.columns(), length));
+	}
 
-		// If there's nothing to sum, don't start the thread, it won't do any
-		// calculations.
-		if (end - start == 1) {
-			for (size_t j = 0; j != length; ++j) {
-				result[j] += arrays[start][j];
-			}
-			continue;
-		}
+	vector<task_args<T>> args;
 
-		vector<long> tempResult(length, 0);
-		args.emplace_back(arrays, std::move(tempResult), start, end);
+	args.reserve(threads);
 
-		pthread_t pthread;
-		if (pthread_create(&pthread, nullptr, &pthread_func, &args.back())) {
-			throw std::runtime_error("can't create thread");
-		}
+	for (size_t i = 0; i != threads; ++i) {
+		size_t start = i * height / threads;
+		size_t end = (i + 1) * height / threads;
 
-		pthreads.push_back(pthread);
+		args.emplace_back(arrays, partials.rows.row(i).data(), start, end);
 	}
 
-	for (pthread_t& thread : pthreads) {
-		pthread_args* threadResult;
-		if (pthread_join(thread, reinterpret_cast<void**>(&threadResult))) {
-			throw std::runtime_error("can't join thread");
-		}
+	// Every band runs on the participant that first touched its rows (see
+	// first_touch()).
+	thread_pool::shared().run_on_each(threads, &task_func<T>, args.data());
+
+	// Merge in parallel: every task adds all partial sums over its own column
+	// range, which starts at a cache line.
+	constexpr size_t perLine = CACHE_LINE_SIZE / sizeof(A);
+	size_t segments = std::clamp<size_t>(length / MERGE_COLUMNS, 1, threads);
+	const matrix<A>& sums = partials.rows;
+
+	thread_pool::shared().run(
+	    segments,
+	    [&](size_t segment) {
+		    size_t start = segment * length / segments / perLine * perLine;
+		    size_t end = segment + 1 == segments
+		                     ? length
+		                     : (segment + 1) * length / segments / perLine * perLine;
+
+		    accumulate_rows(result.data() + start, sums.data() + start,
+		                    sums.stride(), threads, end - start);
+	    },
+	    threads);
 
-		for (size_t i = 0; i != length; ++i) {
-			result[i] += threadResult->result[i];
-		}
-	}
+	return result;
+}
 
-	time_point timeEnd = high_resolution_clock::now();
+#define INSTANTIATE_SUM(T) \
+	template vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads);
 
-	auto ns = (timeEnd - timeStart).count();
-	auto ms = static_cast<double>(ns) / 1000000.0;
-	pout << std::format("Took {}ns ({}ms)\n", ns, ms);
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_SUM)
 
-	return result;
-}
+#undef INSTANTIATE_SUM
 
-}  // namespace row_split
\ No newline at end of file
+}  // namespace row_split
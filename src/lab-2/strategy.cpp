@@ -0,0 +1,70 @@
+#include "strategy.h"
+
+#include <algorithm>
+
+#include "cache.h"
+#include "column_split.h"
+#include "row_split.h"
+#include "tile_split.h"
+
+const char* strategy_name(strategy kind) {
+	switch (kind) {
+		case strategy::row_split:
+			return "row_split";
+		case strategy::column_split:
+			return "column_split";
+		case strategy::tile_split:
+			return "tile_split";
+		default:
+			return "unknown";
+	}
+}
+
+std::optional<strategy> strategy_from_name(std::string_view name) {
+	for (int kind = 0; kind != static_cast<int>(strategy::count); ++kind) {
+		if (name == strategy_name(static_cast<strategy>(kind))) {
+			return static_cast<strategy>(kind);
+		}
+	}
+
+	return std::nullopt;
+}
+
+strategy choose_strategy(size_t rows, size_t columns, size_t threads) {
+	size_t budget = detect_cache_sizes().l2 / 2;
+	threads = std::max<size_t>(threads, 1);
+
+	// Every thread has enough rows and its own full-length accumulator stays
+	// in L2, so the only extra cost is merging |threads| short vectors.
+	if (rows >= 2 * threads && columns * sizeof(long) <= budget) {
+		return strategy::row_split;
+	}
+
+	// Every thread's column range of the single accumulator stays in L2.
+	if (columns >= threads && columns / threads * sizeof(long) <= budget) {
+		return strategy::column_split;
+	}
+
+	return strategy::tile_split;
+}
+
+template <class T>
+vector<accumulator_t<T>> sum(strategy kind, const matrix<T>& arrays,
+                             size_t threads) {
+	switch (kind) {
+		case strategy::row_split:
+			return row_split::sum(arrays, threads);
+		case strategy::column_split:
+			return column_split::sum(arrays, threads);
+		default:
+			return tile_split::sum(arrays, threads);
+	}
+}
+
+#define INSTANTIATE_SUM(T)                                                 \
+	template vector<accumulator_t<T>> sum(strategy kind, const matrix<T>& arrays, \
+	                                      size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_SUM)
+
+#undef INSTANTIATE_SUM
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "element.h"
+#include "matrix.h"
+
+using std::vector;
+
+enum class strategy {
+	row_split,
+	column_split,
+	tile_split,
+	count,
+};
+
+const char* strategy_name(strategy kind);
+
+/** Returns the strategy called |name|, if there is one. */
+std::optional<strategy> strategy_from_name(std::string_view name);
+
+/**
+ * Picks the strategy for summing a |rows| x |columns| matrix with |threads|
+ * threads, based on how its accumulators fit into the detected L2 cache.
+ * Accumulators are 64-bit for every element type.
+ */
+strategy choose_strategy(size_t rows, size_t columns, size_t threads);
+
+template <class T>
+vector<accumulator_t<T>> sum(strategy kind, const matrix<T>& arrays,
+                             size_t threads);
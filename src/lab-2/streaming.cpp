@@ -0,0 +1,290 @@
+#include "streaming.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+#include "accumulate.h"
+#include "matrix_file.h"
+#include "parser.h"
+#include "thread_pool.h"
+
+namespace streaming {
+
+namespace {
+
+/** Size of a single read(). */
+constexpr size_t READ_SIZE = 64 * 1024;
+
+/**
+ * Size that a chunk is filled up to before it's handed over; chunks end at a
+ * line, so a chunk grows past this to hold a longer line.
+ */
+constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+/** Amount of chunks in flight per summing thread. */
+constexpr size_t CHUNKS_PER_THREAD = 2;
+
+template <class T>
+struct stream_state {
+	int fd;
+	size_t k;
+
+	/** Buffers of whole lines, handed between the reader and the summers. */
+	vector<vector<char>> chunks;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	/** Indices of chunks that the reader can fill. */
+	std::deque<size_t> free;
+	/** Indices of chunks waiting to be summed, in input order. */
+	std::deque<size_t> filled;
+	/** Whether the reader has handed over its last chunk. */
+	bool done = false;
+
+	/** Array length, from the first line; published with the first chunk. */
+	size_t length = 0;
+	/** One partial sum per summing thread. */
+	vector<vector<accumulator_t<T>>> partials;
+
+	std::atomic<bool> valid = true;
+	/** Set by the reader if the input can't be summed; checked after the loop. */
+	const char* error = nullptr;
+};
+
+/**
+ * Appends up to READ_SIZE bytes to |text|. Returns the amount read, 0 on EOF
+ * or -1 on errors.
+ */
+ssize_t read_more(int fd, vector<char>& text) {
+	size_t used = text.size();
+	text.resize(used + READ_SIZE);
+
+	ssize_t nRead;
+	do {
+		nRead = read(fd, text.data() + used, READ_SIZE);
+	} while (nRead == -1 && errno == EINTR);
+
+	text.resize(used + static_cast<size_t>(std::max<ssize_t>(nRead, 0)));
+	return nRead;
+}
+
+template <class T>
+void read_chunks(stream_state<T>& state) {
+	vector<char> rest;
+	size_t lines = 0;
+	bool eof = false;
+	bool first = true;
+
+	while (lines != state.k && !eof) {
+		size_t index;
+		{
+			std::unique_lock lock(state.mutex);
+			state.cv.wait(lock, [&] { return !state.free.empty(); });
+			index = state.free.front();
+			state.free.pop_front();
+		}
+
+		vector<char>& text = state.chunks[index];
+		text.assign(rest.begin(), rest.end());
+		rest.clear();
+
+		// Read until the chunk is big enough and ends at a line, and stop at
+		// the k-th line, so a terminal or a pipe which stays open isn't
+		// waited on.
+		size_t scanned = 0;
+		size_t end = 0;
+		while (true) {
+			const char* position = text.data() + scanned;
+			const char* textEnd = text.data() + text.size();
+			while (lines != state.k && position != textEnd) {
+				auto newline = static_cast<const char*>(
+				    std::memchr(position, '\n', textEnd - position));
+				if (!newline) break;
+
+				++lines;
+				position = newline + 1;
+				end = position - text.data();
+			}
+			scanned = text.size();
+
+			if (lines == state.k || (text.size() >= CHUNK_SIZE && end != 0)) {
+				break;
+			}
+
+			ssize_t nRead = read_more(state.fd, text);
+			if (nRead == -1) {
+				state.error = "can't read input";
+			}
+			if (nRead <= 0) {
+				eof = true;
+				break;
+			}
+		}
+
+		if (eof && end != text.size() && lines != state.k) {
+			// The last line has no newline.
+			++lines;
+			end = text.size();
+		}
+
+		rest.assign(text.begin() + end, text.end());
+		text.resize(end);
+
+		if (first) {
+			first = false;
+
+			if (is_matrix_file({text.data(), text.size()})) {
+				state.error = "matrix files can't be streamed; run without --stream";
+				text.clear();
+			}
+
+			std::string_view line(text.data(), text.size());
+			line = line.substr(0, line.find('\n'));
+			state.length = parse_row<T>(line, {});
+		}
+
+		{
+			std::lock_guard lock(state.mutex);
+			state.filled.push_back(index);
+		}
+		state.cv.notify_all();
+
+		if (state.error) break;
+	}
+
+	// Missing lines are empty arrays.
+	if (lines != state.k && state.length != 0) {
+		state.valid.store(false, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard lock(state.mutex);
+		state.done = true;
+	}
+	state.cv.notify_all();
+}
+
+template <class T>
+void sum_chunks(stream_state<T>& state, size_t summer) {
+	vector<accumulator_t<T>>& partial = state.partials[summer];
+	vector<T> row;
+
+	while (true) {
+		size_t index;
+		{
+			std::unique_lock lock(state.mutex);
+			state.cv.wait(lock,
+			              [&] { return !state.filled.empty() || state.done; });
+			if (state.filled.empty()) break;
+
+			index = state.filled.front();
+			state.filled.pop_front();
+		}
+
+		// The length is known once a chunk was handed over.
+		if (partial.size() != state.length) {
+			partial.assign(state.length, 0);
+			row.resize(state.length);
+		}
+
+		const vector<char>& text = state.chunks[index];
+		const char* position = text.data();
+		const char* end = text.data() + text.size();
+
+		while (position != end) {
+			auto newline = static_cast<const char*>(
+			    std::memchr(position, '\n', end - position));
+			const char* lineEnd = newline ? newline : end;
+
+			if (parse_row<T>({position, static_cast<size_t>(lineEnd - position)},
+			                 row) == row.size()) {
+				accumulate_rows(partial.data(), row.data(), 0, 1, row.size());
+			} else {
+				state.valid.store(false, std::memory_order_relaxed);
+			}
+
+			position = newline ? newline + 1 : end;
+		}
+
+		{
+			std::lock_guard lock(state.mutex);
+			state.free.push_back(index);
+		}
+		state.cv.notify_all();
+	}
+}
+
+template <class T>
+void task_func(void* statePtr, size_t index) {
+	auto state = static_cast<stream_state<T>*>(statePtr);
+
+	if (index == 0) {
+		read_chunks(*state);
+	} else {
+		sum_chunks(*state, index - 1);
+	}
+}
+
+}  // namespace
+
+template <class T>
+std::optional<vector<accumulator_t<T>>> sum(int fd, size_t k, size_t threads) {
+	using A = accumulator_t<T>;
+
+	if (k == 0) {
+		return vector<A>();
+	}
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+	}
+
+	stream_state<T> state;
+	state.fd = fd;
+	state.k = k;
+	state.chunks.resize(threads * CHUNKS_PER_THREAD);
+	state.partials.resize(threads);
+	for (size_t i = 0; i != state.chunks.size(); ++i) {
+		state.free.push_back(i);
+	}
+
+	// Every task blocks on the others, so each one needs a thread of its own:
+	// the reader on the calling thread, plus |threads| summers.
+	thread_pool::shared().run_on_each(threads + 1, &task_func<T>, &state);
+
+	if (state.error) {
+		throw std::runtime_error(state.error);
+	}
+	if (!state.valid) {
+		return std::nullopt;
+	}
+
+	vector<A> result(state.length, 0);
+	for (const vector<A>& partial : state.partials) {
+		if (partial.size() == result.size()) {
+			accumulate_rows(result.data(), partial.data(), 0, 1, result.size());
+		}
+	}
+
+	return result;
+}
+
+#define INSTANTIATE_SUM(T)                                                    \
+	template std::optional<vector<accumulator_t<T>>> sum<T>(int fd, size_t k, \
+	                                                        size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_SUM)
+
+#undef INSTANTIATE_SUM
+
+}  // namespace streaming
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "element.h"
+
+using std::vector;
+
+namespace streaming {
+
+/**
+ * Sums |k| arrays of |T| in text read from |fd| while they are being read: a
+ * reader thread cuts the input into chunks of whole lines, and |threads|
+ * threads (0 means one per CPU) parse them and add them into partial sums,
+ * which are merged after the last line. Only a bounded amount of chunks is
+ * in flight, so memory is proportional to |threads| and the array length, not
+ * to |k|.
+ *
+ * Returns nothing if arrays have different lengths. Throws
+ * std::runtime_error on read errors, or if the input is a matrix file.
+ */
+template <class T>
+std::optional<vector<accumulator_t<T>>> sum(int fd, size_t k, size_t threads);
+
+}
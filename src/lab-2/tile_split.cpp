@@ -0,0 +1,97 @@
+#include "tile_split.h"
+
+#include <algorithm>
+
+#include "accumulate.h"
+#include "cache.h"
+#include "thread_pool.h"
+
+namespace tile_split {
+
+/** Rows of one band added to one column segment of an accumulator. */
+template <class T>
+struct tile {
+	const T* data;
+	accumulator_t<T>* result;
+	size_t rows;
+	size_t columns;
+};
+
+size_t tile_width() {
+	// Leave three quarters of L2 to the rows streaming through it. Every
+	// element type has 64-bit accumulators.
+	constexpr size_t perLine = CACHE_LINE_SIZE / sizeof(long);
+	size_t width = detect_cache_sizes().l2 / 4 / sizeof(long);
+
+	return std::max(width / perLine * perLine, 16 * perLine);
+}
+
+template <class T>
+vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads) {
+	using A = accumulator_t<T>;
+
+	size_t length = arrays.columns();
+	size_t height = arrays.rows();
+
+	vector<A> result(length, 0);
+	if (length == 0 || height == 0) return result;
+
+	threads = std::max<size_t>(threads, 1);
+
+	size_t width = std::min(tile_width(), length);
+	size_t segments = (length + width - 1) / width;
+
+	// Split rows into bands only if there are too few segments to keep every
+	// thread busy; each band sums into its own partial accumulator.
+	size_t bands = std::min(height, (threads + segments - 1) / segments);
+
+	matrix<A> partials;
+	if (bands > 1) partials = matrix<A>(bands, length);
+
+	vector<tile<T>> tiles;
+	tiles.reserve(bands * segments);
+
+	for (size_t band = 0; band != bands; ++band) {
+		size_t start = band * height / bands;
+		size_t end = (band + 1) * height / bands;
+		A* target = bands > 1 ? partials.row(band).data() : result.data();
+
+		for (size_t segment = 0; segment != segments; ++segment) {
+			size_t column = segment * width;
+			tiles.push_back({arrays.row(start).data() + column, target + column,
+			                 end - start, std::min(width, length - column)});
+		}
+	}
+
+	thread_pool::shared().run(
+	    tiles.size(),
+	    [&](size_t i) {
+		    const tile<T>& t = tiles[i];
+		    accumulate_rows(t.result, t.data, arrays.stride(), t.rows, t.columns);
+	    },
+	    threads);
+
+	// Merge the bands one column segment at a time.
+	if (bands > 1) {
+		thread_pool::shared().run(
+		    segments,
+		    [&](size_t segment) {
+			    size_t column = segment * width;
+			    accumulate_rows(result.data() + column, partials.data() + column,
+			                    partials.stride(), bands,
+			                    std::min(width, length - column));
+		    },
+		    threads);
+	}
+
+	return result;
+}
+
+#define INSTANTIATE_SUM(T) \
+	template vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_SUM)
+
+#undef INSTANTIATE_SUM
+
+}  // namespace tile_split
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "element.h"
+#include "matrix.h"
+
+using std::vector;
+
+namespace tile_split {
+
+/**
+ * Returns the width, in elements, of the column segments that the matrix is
+ * tiled into, so that a segment of the accumulator stays in L2.
+ */
+size_t tile_width();
+
+template <class T>
+vector<accumulator_t<T>> sum(const matrix<T>& arrays, size_t threads);
+
+}
@@ -0,0 +1,218 @@
+#include "tuner.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "posix_buf.h"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+namespace {
+
+/** Upper bound of the sample that candidates are measured on. */
+constexpr size_t SAMPLE_SIZE = 32 * 1024 * 1024;
+
+/** Every candidate is measured this many times, the best time counts. */
+constexpr int REPEATS = 3;
+
+struct profile_entry {
+	element_type type;
+	int rowsClass;
+	int columnsClass;
+	tuned_config config;
+};
+
+std::vector<profile_entry> read_profile() {
+	std::vector<profile_entry> entries;
+	std::ifstream file(profile_path());
+
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+
+		std::istringstream stream(line);
+		profile_entry entry;
+		std::string typeName;
+		std::string name;
+
+		if (!(stream >> typeName >> entry.rowsClass >> entry.columnsClass >>
+		      name >> entry.config.threads)) {
+			continue;
+		}
+
+		std::optional<element_type> type = element_type_from_name(typeName);
+		std::optional<strategy> kind = strategy_from_name(name);
+		if (!type || !kind || entry.config.threads == 0) continue;
+
+		entry.type = *type;
+		entry.config.kind = *kind;
+		entries.push_back(entry);
+	}
+
+	return entries;
+}
+
+/** Replaces the profile with |entries|; the old one stays if that fails. */
+void write_profile(const std::vector<profile_entry>& entries) {
+	std::filesystem::path path = profile_path();
+	std::filesystem::path temporary = path;
+	temporary += std::format(".{}", getpid());
+
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	{
+		std::ofstream file(temporary);
+		file << "# lab_2 tuning profile: <element type> <rows class> "
+		        "<columns class> <strategy> <threads>\n";
+		for (const profile_entry& entry : entries) {
+			file << std::format("{} {} {} {} {}\n", element_type_name(entry.type),
+			                    entry.rowsClass, entry.columnsClass,
+			                    strategy_name(entry.config.kind),
+			                    entry.config.threads);
+		}
+
+		if (!file.flush()) {
+			perr << "can't write tuning profile " << path.string() << std::endl;
+			std::filesystem::remove(temporary, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporary, path, error);
+}
+
+/** Thread counts to try: powers of two below the CPU count, and the count. */
+std::vector<size_t> thread_candidates() {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t count = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+
+	std::vector<size_t> candidates;
+	for (size_t threads = 1; threads < count; threads *= 2) {
+		candidates.push_back(threads);
+	}
+	candidates.push_back(count);
+
+	return candidates;
+}
+
+/** Returns the best time of summing |arrays|, in seconds. */
+template <class T>
+double measure(strategy kind, const matrix<T>& arrays, size_t threads) {
+	double best = std::numeric_limits<double>::infinity();
+
+	for (int i = 0; i != REPEATS; ++i) {
+		auto start = steady_clock::now();
+		vector<accumulator_t<T>> result = sum(kind, arrays, threads);
+		best = std::min(best, duration<double>(steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+}  // namespace
+
+std::string profile_path() {
+	if (const char* path = std::getenv("LAB_2_PROFILE")) {
+		return path;
+	}
+
+	std::string directory;
+	if (const char* cache = std::getenv("XDG_CACHE_HOME")) {
+		directory = cache;
+	} else if (const char* home = std::getenv("HOME")) {
+		directory = std::string(home) + "/.cache";
+	} else {
+		directory = "/tmp";
+	}
+
+	char host[256] = "localhost";
+	gethostname(host, sizeof(host) - 1);
+
+	return std::format("{}/lab_2/{}.profile", directory, host);
+}
+
+std::optional<tuned_config> profile_lookup(element_type type, size_t rows,
+                                           size_t columns) {
+	int rowsClass = std::bit_width(rows);
+	int columnsClass = std::bit_width(columns);
+
+	for (const profile_entry& entry : read_profile()) {
+		if (entry.type == type && entry.rowsClass == rowsClass &&
+		    entry.columnsClass == columnsClass) {
+			return entry.config;
+		}
+	}
+
+	return std::nullopt;
+}
+
+template <class T>
+tuned_config tune(const matrix<T>& arrays, size_t rows, size_t columns) {
+	tuned_config best = {choose_strategy(rows, columns, 1), 1};
+	if (arrays.rows() == 0 || arrays.columns() == 0) {
+		return best;
+	}
+
+	// Measure on the leading rows, so that calibration stays short.
+	size_t rowSize = arrays.columns() * sizeof(T);
+	size_t sampleRows = std::clamp<size_t>(SAMPLE_SIZE / rowSize, 1, arrays.rows());
+
+	matrix<T> sample(sampleRows, arrays.columns());
+	for (size_t i = 0; i != sampleRows; ++i) {
+		std::ranges::copy(arrays.row(i), sample.row(i).begin());
+	}
+
+	pout << std::format("Tuning on {} x {} {} sample:\n", sampleRows,
+	                    arrays.columns(),
+	                    element_type_name(element_traits<T>::type));
+
+	double bestSeconds = std::numeric_limits<double>::infinity();
+
+	for (int kind = 0; kind != static_cast<int>(strategy::count); ++kind) {
+		for (size_t threads : thread_candidates()) {
+			double seconds = measure(static_cast<strategy>(kind), sample, threads);
+			pout << std::format("  {} threads={} seconds={}\n",
+			                    strategy_name(static_cast<strategy>(kind)), threads,
+			                    seconds);
+
+			if (seconds < bestSeconds) {
+				bestSeconds = seconds;
+				best = {static_cast<strategy>(kind), threads};
+			}
+		}
+	}
+
+	element_type type = element_traits<T>::type;
+	int rowsClass = std::bit_width(rows);
+	int columnsClass = std::bit_width(columns);
+
+	std::vector<profile_entry> entries = read_profile();
+	std::erase_if(entries, [&](const profile_entry& entry) {
+		return entry.type == type && entry.rowsClass == rowsClass &&
+		       entry.columnsClass == columnsClass;
+	});
+	entries.push_back({type, rowsClass, columnsClass, best});
+
+	write_profile(entries);
+
+	return best;
+}
+
+#define INSTANTIATE_TUNE(T) \
+	template tuned_config tune(const matrix<T>& arrays, size_t rows, size_t columns);
+
+FOR_EACH_ELEMENT_TYPE(INSTANTIATE_TUNE)
+
+#undef INSTANTIATE_TUNE
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "element.h"
+#include "matrix.h"
+#include "strategy.h"
+
+/** Strategy and thread count that were fastest for a class of shapes. */
+struct tuned_config {
+	strategy kind;
+	size_t threads;
+};
+
+/**
+ * Returns the path of this machine's profile: $LAB_2_PROFILE if set,
+ * otherwise a per-host file under $XDG_CACHE_HOME (or ~/.cache).
+ */
+std::string profile_path();
+
+/**
+ * Looks up the profile entry for the class of |rows| x |columns| shapes of
+ * |type| elements. Shapes within the same power of two in both dimensions
+ * share an entry.
+ */
+std::optional<tuned_config> profile_lookup(element_type type, size_t rows,
+                                           size_t columns);
+
+/**
+ * Benchmarks every strategy with several thread counts on a sample of
+ * |arrays|, stores the fastest configuration in the profile for the shape
+ * class of |rows| x |columns| of |T| and returns it. Progress is printed to
+ * |pout|.
+ */
+template <class T>
+tuned_config tune(const matrix<T>& arrays, size_t rows, size_t columns);
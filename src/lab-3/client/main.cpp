@@ -9,6 +9,7 @@
 
 #include "lab.h"
 #include "posix_buf.h"
+#include "vowel_filter.h"
 
 int main(int argc, char* argv[]) {
 	if (argc != 4) {
@@ -54,18 +55,10 @@ int main(int argc, char* argv[]) {
 			break;
 		}
 
-		std::string input(shmBuf);
-
-		// Erase vowels from the input.
-		std::erase_if(input, [](char c) {
-			bool lowercase = c == 'a' || c == 'e' || c == 'o' || c == 'i' || c == 'u';
-			bool uppercase = c == 'A' || c == 'E' || c == 'O' || c == 'I' || c == 'U';
-
-			return lowercase || uppercase;
-		});
-
-		// Write back the result.
-		std::strncpy(shmBuf, input.c_str(), MAX_LINE);
+		// Erase vowels from the input, writing the result back in place.
+		size_t length = strnlen(shmBuf, MAX_LINE);
+		length = filter_vowels(shmBuf, length, shmBuf);
+		if (length < MAX_LINE) shmBuf[length] = '\0';
 
 		// Notify parent of the result.
 		sem_post(c2p);
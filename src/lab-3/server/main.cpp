@@ -10,8 +10,10 @@
 // Semaphores
 #include <semaphore.h>
 
+#include "bootleg_stdio.h"
 #include "lab.h"
 #include "posix_buf.h"
+#include "process_spawn.h"
 
 static const size_t CHILDREN = 2;
 
@@ -67,6 +69,8 @@ struct Child {
 	pid_t pid_;
 	/** Output file descriptor. */
 	int output_fd_;
+	/** Buffered writer for the output file. */
+	BlgWriter* output_;
 	/** Path to the P2C semaphore. */
 	std::string lock_path_p2c_;
 	/** Semaphore for parent-to-child communication. */
@@ -76,9 +80,15 @@ struct Child {
 	/** Semaphore for child-to-parent communication. */
 	sem_t* lock_c2p_;
 
-	Child() : pid_(-1), output_fd_(-1), lock_p2c_(nullptr), lock_c2p_(nullptr) {}
+	Child()
+	    : pid_(-1),
+	      output_fd_(-1),
+	      output_(nullptr),
+	      lock_p2c_(nullptr),
+	      lock_c2p_(nullptr) {}
 
 	~Child() {
+		blg_writer_destroy(output_);
 		close(output_fd_);
 		sem_close(lock_p2c_);
 		sem_unlink(lock_path_p2c_.c_str());
@@ -87,6 +97,20 @@ struct Child {
 	}
 };
 
+/** Zeroes the shared memory, notifies all started children to exit and waits. */
+static void stop_children(SharedMemory& shm, std::vector<Child>& children) {
+	std::fill(shm.buf(), shm.buf() + shm.size(), '\0');
+
+	for (auto& child : children) {
+		if (child.pid_ != -1) {
+			sem_post(child.lock_p2c_);
+		}
+	}
+
+	while (wait(nullptr) > 0)
+		;
+}
+
 int main(int argc, char* argv[]) {
 	if (argc != 2) {
 		perr << std::format("usage: {} <client program>", argv[0]);
@@ -95,29 +119,14 @@ int main(int argc, char* argv[]) {
 
 	char* childPath = argv[1];
 
+	// Read the input in the background while children process it.
+	pin_enable_readahead();
+
 	// Initialize and map shared memory.
 	SharedMemory shm(std::format("/line_buffer_{}", getpid()), MAX_LINE);
 
 	std::vector<Child> children(CHILDREN);
 
-	// Prompt the user for filenames and open them.
-	for (size_t i = 0; i != CHILDREN; ++i) {
-		auto& child = children[i];
-
-		pout << "Enter filename of file " << (i + 1) << ": " << std::endl;
-
-		std::string filename;
-		pin >> filename;
-
-		int fd = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
-		if (fd == -1) {
-			perr << "can't open the file for writing" << std::endl;
-			return 5;
-		}
-
-		child.output_fd_ = fd;
-	}
-
 	// Create semaphores.
 	for (size_t i = 0; i != CHILDREN; ++i) {
 		auto& child = children[i];
@@ -143,23 +152,46 @@ int main(int argc, char* argv[]) {
 		child.lock_c2p_ = lockC2p;
 	}
 
-	// Start children.
+	// Start children before the prompts, so that they are loaded by the time
+	// input arrives.
 	for (auto& child : children) {
-		pid_t pid = fork();
+		char* args[] = {childPath, const_cast<char*>(shm.path().c_str()),
+		                const_cast<char*>(child.lock_path_p2c_.c_str()),
+		                const_cast<char*>(child.lock_path_c2p_.c_str()), nullptr};
+
+		pid_t pid = spawn_process(childPath, args, -1, -1);
 		if (pid == -1) {
-			perr << "can't fork() to create a child process" << std::endl;
-			return 7;
+			perr << "can't start child process" << std::endl;
+			stop_children(shm, children);
+			return 8;
+		}
+
+		child.pid_ = pid;
+	}
+
+	// Prompt the user for filenames and open them.
+	for (size_t i = 0; i != CHILDREN; ++i) {
+		auto& child = children[i];
+
+		pout << "Enter filename of file " << (i + 1) << ": " << std::endl;
+
+		std::string filename;
+		pin >> filename;
+
+		int fd = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (fd == -1) {
+			perr << "can't open the file for writing" << std::endl;
+			stop_children(shm, children);
+			return 5;
 		}
-		if (pid == 0) {
-			if (execl(/* path */ childPath, /* argv[0] */ childPath,
-			          /* argv[1] */ shm.path().c_str(),
-			          /* argv[2] */ child.lock_path_p2c_.c_str(),
-			          /* argv[3] */ child.lock_path_c2p_.c_str(), nullptr) == -1) {
-				perr << "can't start child process" << std::endl;
-				return 8;
-			}
-		} else {
-			child.pid_ = pid;
+
+		child.output_fd_ = fd;
+
+		child.output_ = blg_writer_create(fd, BLG_WRITER_CAPACITY);
+		if (!child.output_) {
+			perr << "can't create output buffer" << std::endl;
+			stop_children(shm, children);
+			return 5;
 		}
 	}
 
@@ -194,21 +226,13 @@ int main(int argc, char* argv[]) {
 		std::string response(shm.buf());
 		response.push_back('\n');
 
-		size_t written = write(child.output_fd_, response.data(), response.length());
-		if (written != response.length()) {
+		if (!blg_writer_write(child.output_, response.data(), response.length())) {
 			perr << "can't write to output file" << std::endl;
 		}
 
 		++lines;
 	}
 
-	// EOF received -- zero the shared memory and notify all children to exit.
-	std::fill(shm.buf(), shm.buf() + shm.size(), '\0');
-
-	for (auto& child : children) {
-		sem_post(child.lock_p2c_);
-	}
-
-	while (wait(nullptr) > 0)
-		;
+	// EOF received.
+	stop_children(shm, children);
 }
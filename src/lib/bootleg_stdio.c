@@ -6,81 +6,263 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "line_reader.h"
+
+/** Line reader attached to a file descriptor by |blg_getline|. */
+typedef struct FdReader {
+	int fd;
+	LineReader* reader;
+	struct FdReader* next;
+} FdReader;
+
+static FdReader* fdReaders = NULL;
+
+/** Returns the line reader for |fd|, creating it on first use. */
+static LineReader* get_reader(int fd) {
+	for (FdReader* current = fdReaders; current; current = current->next) {
+		if (current->fd == fd) {
+			return current->reader;
+		}
+	}
+
+	FdReader* entry = (FdReader*)malloc(sizeof(FdReader));
+	if (entry == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	entry->reader = line_reader_create(fd, LINE_READER_CAPACITY);
+	if (entry->reader == NULL) {
+		free(entry);
+		return NULL;
+	}
+
+	entry->fd = fd;
+	entry->next = fdReaders;
+	fdReaders = entry;
+
+	return entry->reader;
+}
+
 ssize_t blg_getline(char** lineptr, size_t n, int stream) {
 	if (lineptr == NULL || (*lineptr != NULL && n == 0)) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (*lineptr == NULL) {
-		n = 16;
+	LineReader* reader = get_reader(stream);
+	if (reader == NULL) {
+		return -1;
+	}
+
+	const char* line;
+	ssize_t length = line_reader_next(reader, &line);
+	if (length == -1) {
+		return -1;
+	}
 
-		// Allocate one more char for the line separator.
-		*lineptr = (char*)malloc((n + 1) * sizeof(char));
-		if (*lineptr == NULL) {
+	// Allocate one more char for the null terminator.
+	if (*lineptr == NULL || n < (size_t)length) {
+		char* newBuffer = (char*)realloc(*lineptr, (length + 1) * sizeof(char));
+		if (newBuffer == NULL) {
 			errno = ENOMEM;
 			return -1;
 		}
+
+		*lineptr = newBuffer;
 	}
 
-	char buffer[256];
-	ssize_t nRead;
-	ssize_t nWritten = 0;
+	memcpy(*lineptr, line, length);
+	(*lineptr)[length] = '\0';
 
-	while ((nRead = read(stream, &buffer, sizeof(buffer))) != 0) {
-		if (nRead == -1) {
-			return -1;
+	return length;
+}
+
+struct BlgWriter {
+	/** File descriptor to write to. */
+	int fd;
+	/** Buffer holding the pending output. */
+	char* buf;
+	/** Size of |buf|. */
+	size_t capacity;
+	/** Amount of pending bytes in |buf|. */
+	size_t length;
+};
+
+BlgWriter* blg_writer_create(int fd, size_t capacity) {
+	if (capacity == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	BlgWriter* writer = (BlgWriter*)malloc(sizeof(BlgWriter));
+	if (writer == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	writer->buf = (char*)malloc(capacity);
+	if (writer->buf == NULL) {
+		free(writer);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	writer->fd = fd;
+	writer->capacity = capacity;
+	writer->length = 0;
+
+	return writer;
+}
+
+void blg_writer_destroy(BlgWriter* writer) {
+	if (!writer) return;
+
+	blg_writer_flush(writer);
+
+	free(writer->buf);
+	free(writer);
+}
+
+/** Writes |length| bytes to |fd|, retrying on partial writes. */
+static bool write_all(int fd, const char* data, size_t length) {
+	while (length) {
+		ssize_t written = write(fd, data, length);
+		if (written == -1) {
+			if (errno == EINTR) continue;
+			return false;
 		}
 
-		for (int i = 0; i != nRead; ++i) {
-			// Current buffer is too small to hold the result.
-			if (nWritten == n) {
-				n *= 2;
+		data += written;
+		length -= written;
+	}
+
+	return true;
+}
 
-				char* newBuffer = (char*)realloc(*lineptr, (n + 1) * sizeof(char));
-				if (newBuffer == NULL) {
-					errno = ENOMEM;
-					return -1;
-				}
+bool blg_writer_flush(BlgWriter* writer) {
+	if (!writer) return false;
 
-				*lineptr = newBuffer;
-			}
+	bool ok = write_all(writer->fd, writer->buf, writer->length);
+	writer->length = 0;
+
+	return ok;
+}
 
-			(*lineptr)[nWritten] = buffer[i];
-			++nWritten;
+bool blg_writer_write(BlgWriter* writer, const char* data, size_t length) {
+	if (!writer || (!data && length)) return false;
 
-			if (buffer[i] == '\n') {
-				(*lineptr)[nWritten] = '\0';
-				return nWritten;
-			}
+	if (length > writer->capacity - writer->length) {
+		if (!blg_writer_flush(writer)) return false;
+
+		// Doesn't fit in the buffer at all, write it directly.
+		if (length >= writer->capacity) {
+			return write_all(writer->fd, data, length);
 		}
 	}
 
-	(*lineptr)[nWritten] = '\0';
-	return nWritten;
+	memcpy(writer->buf + writer->length, data, length);
+	writer->length += length;
+
+	return true;
+}
+
+static bool writer_vprintf(BlgWriter* writer, const char* fmt, va_list args) {
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+
+	// Format straight into the buffer, it usually has enough space.
+	size_t space = writer->capacity - writer->length;
+	int needed = vsnprintf(writer->buf + writer->length, space, fmt, argsCopy);
+	va_end(argsCopy);
+
+	if (needed < 0) return false;
+
+	// vsnprintf() needs space for the null terminator, too.
+	if ((size_t)needed < space) {
+		writer->length += needed;
+		return true;
+	}
+
+	if (!blg_writer_flush(writer)) return false;
+
+	if ((size_t)needed >= writer->capacity) {
+		// The message is longer than the buffer; grow it.
+		size_t capacity = writer->capacity;
+		while (capacity <= (size_t)needed) {
+			capacity *= 2;
+		}
+
+		char* newBuffer = (char*)realloc(writer->buf, capacity);
+		if (newBuffer == NULL) {
+			errno = ENOMEM;
+			return false;
+		}
+
+		writer->buf = newBuffer;
+		writer->capacity = capacity;
+	}
+
+	vsnprintf(writer->buf, writer->capacity, fmt, args);
+	writer->length = needed;
+
+	return true;
+}
+
+bool blg_writer_printf(BlgWriter* writer, const char* fmt, ...) {
+	if (!writer || !fmt) return false;
+
+	va_list args;
+	va_start(args, fmt);
+	bool ok = writer_vprintf(writer, fmt, args);
+	va_end(args);
+
+	return ok;
+}
+
+/** Writer for |blg_printf|, created on first use. */
+static BlgWriter* stdoutWriter = NULL;
+
+static void flush_stdout(void) { blg_flush(); }
+
+static BlgWriter* get_stdout_writer(void) {
+	if (stdoutWriter == NULL) {
+		stdoutWriter = blg_writer_create(STDOUT_FILENO, BLG_WRITER_CAPACITY);
+		if (stdoutWriter != NULL) {
+			atexit(flush_stdout);
+		}
+	}
+
+	return stdoutWriter;
+}
+
+bool blg_flush(void) {
+	return stdoutWriter == NULL || blg_writer_flush(stdoutWriter);
 }
 
 void blg_perrorf(const char* fmt, ...) {
+	blg_flush();
+
 	va_list args;
 	va_start(args, fmt);
 
-	char msg[256];
-	vsnprintf(msg, sizeof(msg), fmt, args);
+	BlgWriter* writer = blg_writer_create(STDERR_FILENO, 256);
+	if (writer != NULL) {
+		writer_vprintf(writer, fmt, args);
+		blg_writer_destroy(writer);
+	}
 
 	va_end(args);
 
-	write(STDERR_FILENO, msg, strlen(msg));
 	exit(EXIT_FAILURE);
 }
 
 void blg_printf(const char* fmt, ...) {
+	BlgWriter* writer = get_stdout_writer();
+	if (writer == NULL) return;
+
 	va_list args;
 	va_start(args, fmt);
-
-	char msg[256];
-	vsnprintf(msg, sizeof(msg), fmt, args);
-
+	writer_vprintf(writer, fmt, args);
 	va_end(args);
-
-	write(STDOUT_FILENO, msg, strlen(msg));
-}
\ No newline at end of file
+}
@@ -1,9 +1,51 @@
 #pragma once
 
+#include <stdbool.h>
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default size of a writer's buffer. */
+#define BLG_WRITER_CAPACITY 4096
+
+struct BlgWriter;
+
+typedef struct BlgWriter BlgWriter;
+
 ssize_t blg_getline(char** lineptr, size_t n, int stream);
 
-void blg_perrorf(const char* fmt, ...);
+/**
+ * Prints a formatted message to stderr and exits. Buffered stdout output is
+ * flushed first.
+ */
+__attribute__((noreturn)) void blg_perrorf(const char* fmt, ...);
+
+/**
+ * Prints a formatted message to stdout. The output is buffered until the
+ * buffer fills up, |blg_flush| is called or the program exits.
+ */
+void blg_printf(const char* fmt, ...);
+
+/** Flushes the buffered output of |blg_printf|. */
+bool blg_flush(void);
+
+/**
+ * Creates a buffered writer for |fd|. Messages longer than |capacity| grow
+ * the buffer; raw writes longer than that bypass it.
+ */
+BlgWriter* blg_writer_create(int fd, size_t capacity);
+
+/** Flushes and destroys the writer. */
+void blg_writer_destroy(BlgWriter* writer);
+
+bool blg_writer_printf(BlgWriter* writer, const char* fmt, ...);
+
+bool blg_writer_write(BlgWriter* writer, const char* data, size_t length);
+
+bool blg_writer_flush(BlgWriter* writer);
 
-void blg_printf(const char* fmt, ...);
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
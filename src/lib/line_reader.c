@@ -0,0 +1,178 @@
+#include "line_reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct LineReader {
+	/** File descriptor to read from. */
+	int fd;
+	/** Buffer holding the data read from |fd|. */
+	char* buf;
+	/** Size of |buf|. */
+	size_t capacity;
+	/** Offset of the first unconsumed byte. */
+	size_t begin;
+	/** Offset up to which |buf| was already searched for a separator. */
+	size_t scanned;
+	/** Offset past the last byte read. */
+	size_t end;
+	/** Whether |fd| has reached EOF. */
+	bool eof;
+};
+
+LineReader* line_reader_create(int fd, size_t capacity) {
+	if (capacity == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	LineReader* reader = (LineReader*)malloc(sizeof(LineReader));
+	if (reader == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	reader->buf = (char*)malloc(capacity);
+	if (reader->buf == NULL) {
+		free(reader);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	reader->fd = fd;
+	reader->capacity = capacity;
+	reader->begin = 0;
+	reader->scanned = 0;
+	reader->end = 0;
+	reader->eof = false;
+
+	return reader;
+}
+
+void line_reader_destroy(LineReader* reader) {
+	if (!reader) return;
+
+	free(reader->buf);
+	free(reader);
+}
+
+/** Reads more data into the buffer, making room for it first. */
+static bool fill(LineReader* reader) {
+	if (reader->begin == reader->end) {
+		// Everything was consumed, start from the beginning of the buffer.
+		reader->begin = reader->scanned = reader->end = 0;
+	} else if (reader->end == reader->capacity && reader->begin != 0) {
+		// Move the incomplete line to the beginning of the buffer.
+		size_t length = reader->end - reader->begin;
+		memmove(reader->buf, reader->buf + reader->begin, length);
+
+		reader->scanned -= reader->begin;
+		reader->end = length;
+		reader->begin = 0;
+	}
+
+	if (reader->end == reader->capacity) {
+		// The line doesn't fit in the buffer at all.
+		size_t capacity = reader->capacity * 2;
+
+		char* newBuffer = (char*)realloc(reader->buf, capacity);
+		if (newBuffer == NULL) {
+			errno = ENOMEM;
+			return false;
+		}
+
+		reader->buf = newBuffer;
+		reader->capacity = capacity;
+	}
+
+	ssize_t nRead;
+	do {
+		nRead = read(reader->fd, reader->buf + reader->end,
+		             reader->capacity - reader->end);
+	} while (nRead == -1 && errno == EINTR);
+
+	if (nRead == -1) {
+		return false;
+	}
+
+	if (nRead == 0) {
+		reader->eof = true;
+	}
+
+	reader->end += nRead;
+	return true;
+}
+
+ssize_t line_reader_next(LineReader* reader, const char** line) {
+	if (reader == NULL || line == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	while (true) {
+		char* start = reader->buf + reader->begin;
+		char* separator = (char*)memchr(reader->buf + reader->scanned, '\n',
+		                                reader->end - reader->scanned);
+
+		if (separator != NULL) {
+			size_t length = separator + 1 - start;
+
+			*line = start;
+			reader->begin += length;
+			reader->scanned = reader->begin;
+
+			return (ssize_t)length;
+		}
+
+		reader->scanned = reader->end;
+
+		if (reader->eof) {
+			// Return the last line, which doesn't have a separator.
+			size_t length = reader->end - reader->begin;
+
+			*line = start;
+			reader->begin = reader->scanned = reader->end;
+
+			return (ssize_t)length;
+		}
+
+		if (!fill(reader)) {
+			return -1;
+		}
+	}
+}
+
+bool line_reader_ready(LineReader* reader) {
+	if (reader == NULL) return false;
+	if (reader->eof) return true;
+
+	char* separator = (char*)memchr(reader->buf + reader->scanned, '\n',
+	                                reader->end - reader->scanned);
+	if (separator == NULL) {
+		reader->scanned = reader->end;
+		return false;
+	}
+
+	return true;
+}
+
+ssize_t line_reader_fill(LineReader* reader) {
+	if (reader == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (reader->eof) return 0;
+
+	// The buffer might get compacted, so compare the amount of unconsumed data.
+	size_t buffered = reader->end - reader->begin;
+	if (!fill(reader)) {
+		return -1;
+	}
+
+	return (ssize_t)(reader->end - reader->begin - buffered);
+}
+
+size_t line_reader_buffered(const LineReader* reader) {
+	return reader ? reader->end - reader->begin : 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/** Default size of the reader's buffer. */
+#define LINE_READER_CAPACITY (64 * 1024)
+
+struct LineReader;
+
+typedef struct LineReader LineReader;
+
+/**
+ * Creates a buffered line reader for |fd|. The buffer starts at |capacity|
+ * bytes and grows when a single line doesn't fit in it.
+ */
+LineReader* line_reader_create(int fd, size_t capacity);
+
+void line_reader_destroy(LineReader* reader);
+
+/**
+ * Reads the next line, including the line separator (if present). |*line|
+ * points into the reader's buffer and stays valid until the next call; it is
+ * not null-terminated.
+ *
+ * Returns the line length, 0 on EOF or -1 on error.
+ */
+ssize_t line_reader_next(LineReader* reader, const char** line);
+
+/**
+ * Returns whether the next call to |line_reader_next| won't block, i.e. a
+ * whole line is buffered or the reader has reached EOF.
+ */
+bool line_reader_ready(LineReader* reader);
+
+/**
+ * Reads from the fd once, without waiting for a whole line, e.g. after poll()
+ * reported it as readable. Returns the amount of bytes read, 0 on EOF or -1
+ * on error.
+ */
+ssize_t line_reader_fill(LineReader* reader);
+
+/**
+ * Returns the amount of bytes read from the fd, but not returned as lines yet.
+ */
+size_t line_reader_buffered(const LineReader* reader);
@@ -1,10 +1,80 @@
 #include "posix_buf.h"
 
+#include "posix_mmap_buf.h"
+
 static posix_streambuf stdoutBuf(STDOUT_FILENO);
 std::ostream pout(&stdoutBuf);
 
-static posix_streambuf stdinBuf(STDIN_FILENO);
-std::istream pin(&stdinBuf);
+/**
+ * Returns the buffer that maps stdin. It's created on first use, so programs
+ * which never read |pin| don't map stdin.
+ */
+static posix_mmap_streambuf& stdin_mmap_buf() {
+	static posix_mmap_streambuf buf(STDIN_FILENO);
+	return buf;
+}
+
+// Map stdin if it's redirected from a regular file, otherwise read it in chunks.
+static std::streambuf* stdin_buf() {
+	if (stdin_mmap_buf().mapped()) return &stdin_mmap_buf();
+
+	static posix_streambuf buf(STDIN_FILENO);
+	return &buf;
+}
+
+/**
+ * Initial buffer of |pin|. The first read puts stdin_buf() in its place; the
+ * read in progress still holds this buffer, so it forwards to stdin_buf().
+ */
+class posix_lazy_stdin_streambuf : public std::streambuf {
+	std::streambuf* source();
+
+   protected:
+	int_type underflow() override { return source()->sgetc(); }
+
+	int_type uflow() override { return source()->sbumpc(); }
+
+	std::streamsize xsgetn(char* s, std::streamsize n) override {
+		return source()->sgetn(s, n);
+	}
+
+	std::streamsize showmanyc() override { return source()->in_avail(); }
+
+	int_type pbackfail(int_type c) override {
+		if (traits_type::eq_int_type(c, traits_type::eof())) {
+			return source()->sungetc();
+		}
+		return source()->sputbackc(traits_type::to_char_type(c));
+	}
+};
+
+static posix_lazy_stdin_streambuf stdinLazyBuf;
+std::istream pin(&stdinLazyBuf);
+
+std::streambuf* posix_lazy_stdin_streambuf::source() {
+	std::streambuf* buf = stdin_buf();
+
+	if (pin.rdbuf() == this) {
+		// rdbuf() clears the state, keep it.
+		std::ios::iostate state = pin.rdstate();
+		pin.rdbuf(buf);
+		pin.setstate(state);
+	}
+
+	return buf;
+}
+
+static std::unique_ptr<posix_readahead_streambuf> stdinReadaheadBuf;
+
+void pin_enable_readahead() {
+	if (pin.rdbuf() != &stdinLazyBuf || stdin_mmap_buf().mapped()) return;
+
+	stdinReadaheadBuf = std::make_unique<posix_readahead_streambuf>(STDIN_FILENO);
+	pin.rdbuf(stdinReadaheadBuf.get());
+}
 
 static posix_streambuf stderrBuf(STDERR_FILENO);
 std::ostream perr(&stderrBuf);
+
+static thread_local posix_record_streambuf threadStderrBuf(STDERR_FILENO);
+thread_local std::ostream terr(&threadStderrBuf);
@@ -1,38 +1,95 @@
 #pragma once
 
+#include <poll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
 #include <istream>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <ostream>
+#include <stdexcept>
 #include <streambuf>
+#include <thread>
 
 extern std::ostream pout;
 extern std::istream pin;
 extern std::ostream perr;
 
+/**
+ * Per-thread counterpart of |perr|, for diagnostics from worker threads. Every
+ * thread has its own buffer, so threads don't contend for a lock. A record
+ * (everything written up to a flush, e.g. std::endl) is passed to write()
+ * whole, and only split if the fd takes part of it. Pipes take records of up
+ * to PIPE_BUF bytes at once, so those don't interleave with other threads'
+ * records; longer ones may.
+ */
+extern thread_local std::ostream terr;
+
+/**
+ * Makes |pin| read stdin ahead on a background thread, so that parsing
+ * overlaps with waiting for input. Does nothing if stdin is mapped into memory.
+ * Must be called before anything is read from |pin|.
+ */
+void pin_enable_readahead();
+
 class posix_streambuf : public std::streambuf {
-	static const size_t BUFFER_SIZE = 4096;
+   public:
+	static const size_t DEFAULT_BUFFER_SIZE = 4096;
 
+   private:
 	int fd_;
-	char in_buf_[BUFFER_SIZE];
-	char out_buf_[BUFFER_SIZE];
+	size_t buffer_size_;
+	std::unique_ptr<char[]> in_buf_;
+	std::unique_ptr<char[]> out_buf_;
 
-	bool flush() {
-		size_t length = pptr() - pbase();
+	/** Writes |iov| to the file, retrying on partial writes. */
+	bool write_all(iovec *iov, int count) {
+		while (count) {
+			ssize_t written = writev(fd_, iov, count);
+			if (written == -1) {
+				if (errno == EINTR) continue;
+				return false;
+			}
+
+			// Skip the buffers that were written completely.
+			auto remaining = static_cast<size_t>(written);
+			while (count && remaining >= iov->iov_len) {
+				remaining -= iov->iov_len;
+				++iov;
+				--count;
+			}
 
-		if (length) {
-			ssize_t written = write(fd_, pbase(), length);
-			if (written != length) return false;
+			if (count) {
+				iov->iov_base = static_cast<char *>(iov->iov_base) + remaining;
+				iov->iov_len -= remaining;
+			}
 		}
 
-		setp(out_buf_, out_buf_ + BUFFER_SIZE);
 		return true;
 	}
 
+	bool flush() {
+		iovec iov{pbase(), static_cast<size_t>(pptr() - pbase())};
+		bool ok = write_all(&iov, 1);
+
+		setp(out_buf_.get(), out_buf_.get() + buffer_size_);
+		return ok;
+	}
+
    public:
-	explicit posix_streambuf(int fd) : fd_(fd), in_buf_(), out_buf_() {
-		setp(out_buf_, out_buf_ + BUFFER_SIZE);
-		setg(in_buf_, in_buf_ + BUFFER_SIZE, in_buf_ + BUFFER_SIZE);
+	explicit posix_streambuf(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE)
+	    : fd_(fd),
+	      buffer_size_(bufferSize),
+	      in_buf_(new char[bufferSize]),
+	      out_buf_(new char[bufferSize]) {
+		setp(out_buf_.get(), out_buf_.get() + buffer_size_);
+		setg(in_buf_.get(), in_buf_.get() + buffer_size_,
+		     in_buf_.get() + buffer_size_);
 	}
 
 	~posix_streambuf() { flush(); }
@@ -41,12 +98,27 @@ class posix_streambuf : public std::streambuf {
 	int sync() override { return flush() ? 0 : -1; }
 
 	std::streamsize xsputn(const char *s, std::streamsize n) override {
+		std::streamsize space = epptr() - pptr();
+
+		if (n > space && static_cast<size_t>(n) >= buffer_size_) {
+			// Large payload: write the buffered data and the payload together,
+			// without copying the payload into the buffer.
+			iovec iov[2] = {
+			    {pbase(), static_cast<size_t>(pptr() - pbase())},
+			    {const_cast<char *>(s), static_cast<size_t>(n)},
+			};
+			bool ok = write_all(iov, 2);
+
+			setp(out_buf_.get(), out_buf_.get() + buffer_size_);
+			return ok ? n : 0;
+		}
+
 		std::streamsize total = 0;
 
 		while (n) {
-			std::streamsize space = epptr() - pptr();
+			space = epptr() - pptr();
 			if (!space) {
-				if (!flush()) return 0;
+				if (!flush()) return total;
 				space = epptr() - pptr();
 			}
 
@@ -81,6 +153,18 @@ class posix_streambuf : public std::streambuf {
 		while (n) {
 			std::streamsize space = egptr() - gptr();
 			if (!space) {
+				if (static_cast<size_t>(n) >= buffer_size_) {
+					// Large read: bypass the buffer and read into |s| directly.
+					ssize_t nRead = ::read(fd_, s, n);
+					if (nRead == -1 && errno == EINTR) continue;
+					if (nRead <= 0) break;
+
+					s += nRead;
+					n -= nRead;
+					total += nRead;
+					continue;
+				}
+
 				if (underflow() == traits_type::eof()) break;
 				space = egptr() - gptr();
 			}
@@ -103,12 +187,242 @@ class posix_streambuf : public std::streambuf {
 			return traits_type::to_int_type(*gptr());
 		}
 
-		ssize_t nRead = read(fd_, in_buf_, BUFFER_SIZE);
+		ssize_t nRead = read(fd_, in_buf_.get(), buffer_size_);
 		if (nRead <= 0) {
 			return traits_type::eof();
 		}
 
-		setg(in_buf_, in_buf_, in_buf_ + nRead);
+		setg(in_buf_.get(), in_buf_.get(), in_buf_.get() + nRead);
+		return traits_type::to_int_type(*gptr());
+	}
+};
+
+/**
+ * Output-only stream buffer which keeps the whole record in memory until it's
+ * flushed. The buffer grows instead of flushing, so a record is passed to
+ * write() in one piece.
+ */
+class posix_record_streambuf : public std::streambuf {
+   public:
+	static const size_t DEFAULT_BUFFER_SIZE = 1024;
+
+   private:
+	int fd_;
+	std::vector<char> buf_;
+
+	bool flush() {
+		const char *data = pbase();
+		size_t length = pptr() - pbase();
+
+		while (length) {
+			ssize_t written = write(fd_, data, length);
+			if (written == -1) {
+				if (errno == EINTR) continue;
+				break;
+			}
+
+			data += written;
+			length -= written;
+		}
+
+		setp(buf_.data(), buf_.data() + buf_.size());
+		return length == 0;
+	}
+
+	/** Moves the put pointer |n| characters on; pbump() only takes an int. */
+	void advance(size_t n) {
+		while (n) {
+			size_t step = std::min<size_t>(n, INT_MAX);
+			pbump(static_cast<int>(step));
+			n -= step;
+		}
+	}
+
+	/** Makes room for at least |n| more characters. */
+	void grow(size_t n) {
+		size_t used = pptr() - pbase();
+		buf_.resize(std::max(buf_.size() * 2, used + n));
+
+		setp(buf_.data(), buf_.data() + buf_.size());
+		advance(used);
+	}
+
+   public:
+	explicit posix_record_streambuf(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE)
+	    : fd_(fd), buf_(bufferSize) {
+		setp(buf_.data(), buf_.data() + buf_.size());
+	}
+
+	~posix_record_streambuf() { flush(); }
+
+   protected:
+	int sync() override { return flush() ? 0 : -1; }
+
+	std::streamsize xsputn(const char *s, std::streamsize n) override {
+		if (n > epptr() - pptr()) grow(n);
+
+		std::copy(s, s + n, pptr());
+		advance(n);
+
+		return n;
+	}
+
+	int_type overflow(int_type c) override {
+		if (c != EOF) {
+			grow(1);
+
+			*pptr() = static_cast<char>(c);
+			pbump(1);
+		}
+
+		return traits_type::not_eof(c);
+	}
+};
+
+/**
+ * Input-only stream buffer which reads the fd on a background thread. The
+ * thread fills a ring of buffers while the consumer parses the current one;
+ * buffers are handed over without copying.
+ */
+class posix_readahead_streambuf : public std::streambuf {
+   public:
+	static const size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+	static const size_t DEFAULT_BUFFER_COUNT = 4;
+
+   private:
+	struct chunk {
+		std::unique_ptr<char[]> data;
+		size_t length;
+	};
+
+	int fd_;
+	size_t buffer_size_;
+	std::vector<chunk> chunks_;
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	/** Next chunk to be consumed. */
+	size_t read_index_;
+	/** Next chunk to be filled. */
+	size_t write_index_;
+	/** Amount of filled chunks, waiting to be consumed. */
+	size_t filled_;
+	/** Whether the consumer holds a chunk (the one before |read_index_|). */
+	bool holding_;
+	/** Whether the fd has reached EOF or failed. */
+	bool eof_;
+	/** Whether the reader thread should exit. */
+	bool stop_;
+
+	/** Pipe used to wake up the reader thread when it waits for input. */
+	int stop_pipe_[2];
+	std::thread thread_;
+
+	void reader_func() {
+		while (true) {
+			size_t index;
+			{
+				std::unique_lock lock(mutex_);
+				cv_.wait(lock, [this] {
+					return stop_ || filled_ + holding_ < chunks_.size();
+				});
+				if (stop_) return;
+
+				index = write_index_;
+			}
+
+			pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+			if (poll(fds, 2, -1) == -1) {
+				if (errno == EINTR) continue;
+				break;
+			}
+			if (fds[1].revents) return;
+
+			ssize_t nRead = read(fd_, chunks_[index].data.get(), buffer_size_);
+			if (nRead == -1 && errno == EINTR) continue;
+			if (nRead <= 0) break;
+
+			std::lock_guard lock(mutex_);
+			chunks_[index].length = nRead;
+			write_index_ = (write_index_ + 1) % chunks_.size();
+			++filled_;
+			cv_.notify_all();
+		}
+
+		std::lock_guard lock(mutex_);
+		eof_ = true;
+		cv_.notify_all();
+	}
+
+   public:
+	explicit posix_readahead_streambuf(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE,
+	                                   size_t bufferCount = DEFAULT_BUFFER_COUNT)
+	    : fd_(fd),
+	      buffer_size_(bufferSize),
+	      chunks_(std::max<size_t>(bufferCount, 2)),
+	      read_index_(0),
+	      write_index_(0),
+	      filled_(0),
+	      holding_(false),
+	      eof_(false),
+	      stop_(false) {
+		for (chunk &buf : chunks_) {
+			buf.data.reset(new char[bufferSize]);
+			buf.length = 0;
+		}
+
+		if (pipe(stop_pipe_) == -1) {
+			throw std::runtime_error("can't create pipe");
+		}
+
+		setg(nullptr, nullptr, nullptr);
+		thread_ = std::thread(&posix_readahead_streambuf::reader_func, this);
+	}
+
+	// copying this shouldn't be possible
+	posix_readahead_streambuf(const posix_readahead_streambuf &) = delete;
+	posix_readahead_streambuf &operator=(const posix_readahead_streambuf &) = delete;
+
+	~posix_readahead_streambuf() {
+		{
+			std::lock_guard lock(mutex_);
+			stop_ = true;
+			cv_.notify_all();
+		}
+
+		write(stop_pipe_[1], "", 1);
+		thread_.join();
+
+		close(stop_pipe_[0]);
+		close(stop_pipe_[1]);
+	}
+
+   protected:
+	int_type underflow() override {
+		if (gptr() < egptr()) {
+			return traits_type::to_int_type(*gptr());
+		}
+
+		std::unique_lock lock(mutex_);
+
+		// Give the current chunk back to the reader thread.
+		if (holding_) {
+			holding_ = false;
+			cv_.notify_all();
+		}
+
+		cv_.wait(lock, [this] { return filled_ || eof_; });
+		if (!filled_) {
+			setg(nullptr, nullptr, nullptr);
+			return traits_type::eof();
+		}
+
+		chunk &buf = chunks_[read_index_];
+		read_index_ = (read_index_ + 1) % chunks_.size();
+		--filled_;
+		holding_ = true;
+
+		setg(buf.data.get(), buf.data.get(), buf.data.get() + buf.length);
 		return traits_type::to_int_type(*gptr());
 	}
-};
\ No newline at end of file
+};
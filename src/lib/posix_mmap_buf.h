@@ -0,0 +1,83 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <streambuf>
+
+/**
+ * Read-only stream buffer which maps a regular file into memory and exposes
+ * the mapping as the get area, so reading doesn't need any syscalls or copies.
+ */
+class posix_mmap_streambuf : public std::streambuf {
+	/** Mapped file contents. */
+	char *data_;
+	/** Size of the mapping. */
+	size_t size_;
+	/** Whether |fd| was mapped (or is an empty regular file). */
+	bool mapped_;
+
+   public:
+	explicit posix_mmap_streambuf(int fd)
+	    : data_(nullptr), size_(0), mapped_(false) {
+		struct stat st;
+		if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+			return;
+		}
+
+		// Continue from the current file offset, e.g. if something was read
+		// already.
+		off_t offset = lseek(fd, 0, SEEK_CUR);
+		if (offset == -1 || offset > st.st_size) {
+			return;
+		}
+
+		size_ = static_cast<size_t>(st.st_size);
+		mapped_ = true;
+
+		if (offset == st.st_size) {
+			// Nothing to map, the stream is at EOF.
+			size_ = 0;
+			return;
+		}
+
+		void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			size_ = 0;
+			mapped_ = false;
+			return;
+		}
+
+		data_ = static_cast<char *>(data);
+		madvise(data_, size_, MADV_SEQUENTIAL);
+		madvise(data_, size_, MADV_WILLNEED);
+
+		setg(data_, data_ + offset, data_ + size_);
+	}
+
+	// copying this shouldn't be possible
+	posix_mmap_streambuf(const posix_mmap_streambuf &) = delete;
+	posix_mmap_streambuf &operator=(const posix_mmap_streambuf &) = delete;
+
+	~posix_mmap_streambuf() {
+		if (data_) munmap(data_, size_);
+	}
+
+	/** Returns whether the file was mapped. If not, use a buffered stream. */
+	bool mapped() const { return mapped_; }
+
+   protected:
+	int_type underflow() override {
+		if (gptr() < egptr()) {
+			return traits_type::to_int_type(*gptr());
+		}
+
+		// The whole file is in the get area already.
+		return traits_type::eof();
+	}
+
+	std::streamsize showmanyc() override {
+		return gptr() < egptr() ? egptr() - gptr() : -1;
+	}
+};
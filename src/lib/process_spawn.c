@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+
+#include "process_spawn.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+struct SpawnPool {
+	const char* path;
+	char* const* argv;
+	/** Ready workers; the ones at [count, size) were taken. */
+	SpawnedProcess* workers;
+	size_t size;
+	size_t count;
+};
+
+pid_t spawn_process(const char* path, char* const argv[], int stdinFd, int stdoutFd) {
+	posix_spawn_file_actions_t actions;
+
+	int error = posix_spawn_file_actions_init(&actions);
+	if (error) {
+		errno = error;
+		return -1;
+	}
+
+	if (stdinFd != -1) {
+		error = posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO);
+	}
+	if (!error && stdoutFd != -1) {
+		error = posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO);
+	}
+
+	// glibc spawns with CLONE_VM | CLONE_VFORK, so the parent's page tables
+	// aren't copied no matter how large it is.
+	pid_t pid = -1;
+	if (!error) {
+		error = posix_spawn(&pid, path, &actions, NULL, argv, environ);
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (error) {
+		errno = error;
+		return -1;
+	}
+
+	return pid;
+}
+
+static bool spawn_worker(SpawnPool* pool, SpawnedProcess* worker) {
+	int input[2], output[2];
+
+	if (pipe2(input, O_CLOEXEC) == -1) {
+		return false;
+	}
+	if (pipe2(output, O_CLOEXEC) == -1) {
+		close(input[0]);
+		close(input[1]);
+		return false;
+	}
+
+	pid_t pid = spawn_process(pool->path, pool->argv, input[0], output[1]);
+
+	close(input[0]);
+	close(output[1]);
+
+	if (pid == -1) {
+		close(input[1]);
+		close(output[0]);
+		return false;
+	}
+
+	*worker = (SpawnedProcess){pid, input[1], output[0]};
+	return true;
+}
+
+SpawnPool* spawn_pool_create(const char* path, char* const argv[], size_t size) {
+	SpawnPool* pool = (SpawnPool*)malloc(sizeof(SpawnPool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->workers = (SpawnedProcess*)malloc(size * sizeof(SpawnedProcess));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pool->path = path;
+	pool->argv = argv;
+	pool->size = size;
+	pool->count = 0;
+
+	if (!spawn_pool_fill(pool)) {
+		spawn_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void spawn_pool_destroy(SpawnPool* pool) {
+	if (pool == NULL) return;
+
+	// Workers exit on EOF.
+	for (size_t i = 0; i != pool->count; ++i) {
+		close(pool->workers[i].input);
+		close(pool->workers[i].output);
+	}
+	for (size_t i = 0; i != pool->count; ++i) {
+		waitpid(pool->workers[i].pid, NULL, 0);
+	}
+
+	free(pool->workers);
+	free(pool);
+}
+
+bool spawn_pool_take(SpawnPool* pool, SpawnedProcess* worker) {
+	if (pool->count == 0) {
+		return false;
+	}
+
+	*worker = pool->workers[--pool->count];
+	return true;
+}
+
+bool spawn_pool_fill(SpawnPool* pool) {
+	while (pool->count != pool->size) {
+		if (!spawn_worker(pool, &pool->workers[pool->count])) {
+			return false;
+		}
+		++pool->count;
+	}
+
+	return true;
+}
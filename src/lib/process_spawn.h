@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct SpawnPool;
+
+typedef struct SpawnPool SpawnPool;
+
+/** Worker started by a pool, with pipes to its stdin and from its stdout. */
+typedef struct SpawnedProcess {
+	pid_t pid;
+	/** Write end of the pipe to the worker's stdin. */
+	int input;
+	/** Read end of the pipe from the worker's stdout. */
+	int output;
+} SpawnedProcess;
+
+/**
+ * Starts |path| with |argv| via posix_spawn and returns its pid, or -1 on
+ * error. The child's stdin and stdout are redirected to |stdinFd| and
+ * |stdoutFd| by the spawn file actions; -1 keeps the parent's stream.
+ *
+ * Nothing runs in the child before exec, so descriptors that the child must
+ * not inherit have to be opened with O_CLOEXEC.
+ */
+pid_t spawn_process(const char* path, char* const argv[], int stdinFd, int stdoutFd);
+
+/**
+ * Starts |size| workers up front, so that they are loaded by the time work
+ * arrives. |argv| must stay valid until the pool is destroyed.
+ */
+SpawnPool* spawn_pool_create(const char* path, char* const argv[], size_t size);
+
+/** Closes the pipes of the workers that weren't taken and reaps them. */
+void spawn_pool_destroy(SpawnPool* pool);
+
+/**
+ * Hands out a warm worker. The caller owns its pipes and must reap it. Returns
+ * false if the pool is empty.
+ */
+bool spawn_pool_take(SpawnPool* pool, SpawnedProcess* worker);
+
+/** Starts workers in place of the taken ones. Returns false on error. */
+bool spawn_pool_fill(SpawnPool* pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,212 @@
+#include "thread_pool.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define THREAD_POOL_PAUSE() _mm_pause()
+#else
+#define THREAD_POOL_PAUSE() ((void)0)
+#endif
+
+namespace {
+
+/** Amount of spins before parking; a few microseconds on current CPUs. */
+constexpr int SPIN_LIMIT = 2000;
+
+/**
+ * Returns the amount of spins before parking. On a single CPU spinning only
+ * delays the thread that is being waited for.
+ */
+int spin_limit() {
+	static const int limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_LIMIT : 0;
+	return limit;
+}
+
+/** Waits until |value| differs from |old|; returns the new value. */
+template <class T>
+T wait_for_change(std::atomic<T> &value, T old) {
+	for (int i = 0; i != spin_limit(); ++i) {
+		T current = value.load(std::memory_order_acquire);
+		if (current != old) return current;
+		THREAD_POOL_PAUSE();
+	}
+
+	T current;
+	while ((current = value.load(std::memory_order_acquire)) == old) {
+		value.wait(old, std::memory_order_acquire);
+	}
+	return current;
+}
+
+}  // namespace
+
+thread_pool::thread_pool()
+    : busy_(0),
+      next_(0),
+      stop_(false),
+      task_(nullptr),
+      context_(nullptr),
+      count_(0),
+      fixed_(false) {}
+
+thread_pool::~thread_pool() {
+	stop_.store(true, std::memory_order_relaxed);
+
+	for (auto &worker : workers_) {
+		worker->wake.fetch_add(1, std::memory_order_release);
+		worker->wake.notify_one();
+	}
+
+	for (auto &worker : workers_) {
+		pthread_join(worker->thread, nullptr);
+	}
+}
+
+thread_pool &thread_pool::shared() {
+	static thread_pool pool;
+	return pool;
+}
+
+void *thread_pool::worker_func(void *arg) {
+	auto self = static_cast<worker *>(arg);
+	thread_pool *pool = self->pool;
+
+	while (true) {
+		self->seen = wait_for_change(self->wake, self->seen);
+
+		if (pool->stop_.load(std::memory_order_relaxed)) break;
+
+		pool->work(self->index + 1);
+
+		if (pool->busy_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			pool->busy_.notify_one();
+		}
+	}
+
+	return nullptr;
+}
+
+void thread_pool::work(size_t participant) {
+	if (fixed_) {
+		if (participant < count_) task_(context_, participant);
+		return;
+	}
+
+	size_t index;
+	while ((index = next_.fetch_add(1, std::memory_order_relaxed)) < count_) {
+		task_(context_, index);
+	}
+}
+
+void thread_pool::reserve(size_t count) {
+	while (workers_.size() < count) {
+		auto self = std::make_unique<worker>();
+		self->pool = this;
+		self->index = workers_.size();
+		self->wake.store(0, std::memory_order_relaxed);
+		self->seen = 0;
+
+		if (pthread_create(&self->thread, nullptr, &worker_func, self.get())) {
+			throw std::runtime_error("can't create thread");
+		}
+
+		pin_thread(self->thread, self->index + 1);
+		workers_.push_back(std::move(self));
+	}
+}
+
+void thread_pool::pin_thread(pthread_t thread, size_t participant) {
+	if (cpus_.empty()) return;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpus_[participant % cpus_.size()], &set);
+
+	// Pinning is an optimization; a CPU outside the allowed set just stays
+	// unpinned.
+	pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+void thread_pool::pin(std::vector<int> cpus) {
+	std::lock_guard lock(run_mutex_);
+
+	cpus_ = std::move(cpus);
+
+	if (cpus_.empty()) {
+		// Unpin by allowing every CPU the process may use.
+		cpu_set_t set;
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			for (auto &worker : workers_) {
+				pthread_setaffinity_np(worker->thread, sizeof(set), &set);
+			}
+		}
+		return;
+	}
+
+	pin_thread(pthread_self(), 0);
+	for (auto &worker : workers_) {
+		pin_thread(worker->thread, worker->index + 1);
+	}
+}
+
+void thread_pool::run(size_t count, task_fn task, void *context,
+                      size_t threads) {
+	if (count == 0) return;
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+	}
+
+	std::lock_guard lock(run_mutex_);
+	run_loop(count, task, context, std::min(count, threads) - 1, false);
+}
+
+void thread_pool::run_on_each(size_t threads, task_fn task, void *context) {
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+	}
+
+	std::lock_guard lock(run_mutex_);
+	run_loop(threads, task, context, threads - 1, true);
+}
+
+void thread_pool::run_loop(size_t count, task_fn task, void *context,
+                           size_t helpers, bool fixed) {
+	if (helpers == 0) {
+		for (size_t i = 0; i != count; ++i) {
+			task(context, i);
+		}
+		return;
+	}
+
+	reserve(helpers);
+
+	task_ = task;
+	context_ = context;
+	count_ = count;
+	fixed_ = fixed;
+	next_.store(0, std::memory_order_relaxed);
+	busy_.store(static_cast<uint32_t>(helpers), std::memory_order_relaxed);
+
+	// Wake only the participants: the others keep waiting for a loop of their
+	// own and never read the fields above while they change.
+	for (size_t i = 0; i != helpers; ++i) {
+		workers_[i]->wake.fetch_add(1, std::memory_order_release);
+		workers_[i]->wake.notify_one();
+	}
+
+	work(0);
+
+	uint32_t busy;
+	while ((busy = busy_.load(std::memory_order_acquire)) != 0) {
+		wait_for_change(busy_, busy);
+	}
+}
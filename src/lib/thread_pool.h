@@ -0,0 +1,142 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Pool of persistent pthreads which run parallel loops. Idle workers spin for
+ * a few microseconds and then park on a futex, so a loop started right after
+ * the previous one doesn't pay for a wake-up, and an idle pool doesn't burn
+ * CPU.
+ */
+class thread_pool {
+   public:
+	using task_fn = void (*)(void *context, size_t index);
+
+   private:
+	struct worker {
+		thread_pool *pool;
+		/**
+		 * Position in |workers_|. The worker is participant |index + 1| of a
+		 * loop, the caller is 0.
+		 */
+		size_t index;
+		pthread_t thread;
+		/**
+		 * Incremented for every loop the worker takes part in, and on stop.
+		 * Only participants are woken, so idle workers never look at a loop.
+		 */
+		std::atomic<uint32_t> wake;
+		/** Value of |wake| when the worker last woke up. */
+		uint32_t seen;
+	};
+
+	std::vector<std::unique_ptr<worker>> workers_;
+	/** Serializes loops started from different threads. */
+	std::mutex run_mutex_;
+	/** CPUs that participants are pinned to, in order; empty if unpinned. */
+	std::vector<int> cpus_;
+
+	/** Amount of workers that haven't finished the current loop yet. */
+	std::atomic<uint32_t> busy_;
+	/** Index of the next task to run. */
+	std::atomic<size_t> next_;
+	std::atomic<bool> stop_;
+
+	/**
+	 * The current loop. Written before its participants are woken and only
+	 * changed once all of them have finished it.
+	 */
+	task_fn task_;
+	void *context_;
+	size_t count_;
+	/** Whether every participant runs the task with its own index. */
+	bool fixed_;
+
+	static void *worker_func(void *arg);
+
+	/**
+	 * Runs tasks of the current loop until there are none left, or only the
+	 * task of |participant| if the loop is fixed.
+	 */
+	void work(size_t participant);
+
+	/** Adds workers until there are |count| of them. */
+	void reserve(size_t count);
+
+	/** Pins |thread| to the CPU of |participant|, if the pool is pinned. */
+	void pin_thread(pthread_t thread, size_t participant);
+
+	/** Publishes a loop to |helpers| workers, joins it and waits for it. */
+	void run_loop(size_t count, task_fn task, void *context, size_t helpers,
+	              bool fixed);
+
+	/** Task that calls the |F| at |context| with the task index. */
+	template <class F>
+	static void call(void *context, size_t index) {
+		(*static_cast<std::remove_reference_t<F> *>(context))(index);
+	}
+
+	template <class F>
+	static void *to_context(F &func) {
+		return const_cast<void *>(static_cast<const void *>(&func));
+	}
+
+   public:
+	thread_pool();
+
+	// copying this shouldn't be possible
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	~thread_pool();
+
+	/** Returns the process-wide pool. */
+	static thread_pool &shared();
+
+	/** Returns the amount of started workers. */
+	size_t size() const { return workers_.size(); }
+
+	/**
+	 * Pins the calling thread to |cpus[0]| and worker |i| to
+	 * |cpus[(i + 1) % cpus.size()]|, including workers started later. An
+	 * empty list unpins them.
+	 */
+	void pin(std::vector<int> cpus);
+
+	/**
+	 * Calls |task(context, i)| for every |i| in [0, count) on at most
+	 * |threads| threads (0 means one per CPU) and returns when all calls have
+	 * finished. The calling thread runs tasks too; workers are started on
+	 * demand.
+	 */
+	void run(size_t count, task_fn task, void *context, size_t threads = 0);
+
+	/** Same as above, for any callable taking the task index. */
+	template <class F>
+	void run(size_t count, F &&func, size_t threads = 0) {
+		run(count, &call<F>, to_context(func), threads);
+	}
+
+	/**
+	 * Calls |task(context, i)| for every |i| in [0, threads) (0 means one per
+	 * CPU), each on its own thread: the calling thread runs 0, and worker
+	 * |i - 1| runs |i|. Every call with the same |i| runs on the same thread,
+	 * and on the same CPU if the pool is pinned, so memory that task |i|
+	 * touched first stays local to it in later loops.
+	 */
+	void run_on_each(size_t threads, task_fn task, void *context);
+
+	/** Same as above, for any callable taking the task index. */
+	template <class F>
+	void run_on_each(size_t threads, F &&func) {
+		run_on_each(threads, &call<F>, to_context(func));
+	}
+};
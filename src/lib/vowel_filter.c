@@ -0,0 +1,222 @@
+#include "vowel_filter.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VOWEL_FILTER_X86
+#include <immintrin.h>
+#endif
+
+inline static bool is_vowel(char c) {
+	// Setting 0x20 makes letters lowercase; no other char turns into a vowel.
+	char lower = (char)(c | 0x20);
+	return lower == 'a' || lower == 'e' || lower == 'o' || lower == 'i' ||
+	       lower == 'u';
+}
+
+static size_t filter_scalar(const char* in, size_t length, char* out) {
+	size_t j = 0;
+
+	// Always copy the char, but only advance past it if it isn't a vowel.
+	for (size_t i = 0; i != length; ++i) {
+		char c = in[i];
+		out[j] = c;
+		j += !is_vowel(c);
+	}
+
+	return j;
+}
+
+#ifdef VOWEL_FILTER_X86
+
+/**
+ * Shuffle masks which move the bytes selected by an 8-bit mask to the front of
+ * a 64-bit word.
+ */
+static uint64_t compressTable[256];
+
+static void init_compress_table(void) {
+	for (unsigned mask = 0; mask != 256; ++mask) {
+		uint64_t shuffle = 0;
+		unsigned n = 0;
+
+		for (unsigned bit = 0; bit != 8; ++bit) {
+			if (mask & (1u << bit)) {
+				shuffle |= (uint64_t)bit << (8 * n++);
+			}
+		}
+
+		// Zero the unused bytes.
+		for (; n != 8; ++n) {
+			shuffle |= (uint64_t)0x80 << (8 * n);
+		}
+
+		compressTable[mask] = shuffle;
+	}
+}
+
+__attribute__((target("sse2"))) static size_t filter_sse2(const char* in,
+                                                          size_t length,
+                                                          char* out) {
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	size_t i = 0, j = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i chars = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i lower = _mm_or_si128(chars, caseBit);
+
+		__m128i vowels = _mm_cmpeq_epi8(lower, _mm_set1_epi8('a'));
+		vowels = _mm_or_si128(vowels, _mm_cmpeq_epi8(lower, _mm_set1_epi8('e')));
+		vowels = _mm_or_si128(vowels, _mm_cmpeq_epi8(lower, _mm_set1_epi8('i')));
+		vowels = _mm_or_si128(vowels, _mm_cmpeq_epi8(lower, _mm_set1_epi8('o')));
+		vowels = _mm_or_si128(vowels, _mm_cmpeq_epi8(lower, _mm_set1_epi8('u')));
+
+		unsigned keep = ~(unsigned)_mm_movemask_epi8(vowels) & 0xFFFF;
+
+		if (keep == 0xFFFF) {
+			_mm_storeu_si128((__m128i*)(out + j), chars);
+			j += 16;
+			continue;
+		}
+
+		// SSE2 can't shuffle bytes, copy the kept ones one by one.
+		while (keep) {
+			out[j++] = in[i + __builtin_ctz(keep)];
+			keep &= keep - 1;
+		}
+	}
+
+	return j + filter_scalar(in + i, length - i, out + j);
+}
+
+__attribute__((target("avx2"))) static size_t filter_avx2(const char* in,
+                                                          size_t length,
+                                                          char* out) {
+	const __m256i caseBit = _mm256_set1_epi8(0x20);
+	size_t i = 0, j = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i chars = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i lower = _mm256_or_si256(chars, caseBit);
+
+		__m256i vowels = _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('a'));
+		vowels = _mm256_or_si256(vowels, _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('e')));
+		vowels = _mm256_or_si256(vowels, _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('i')));
+		vowels = _mm256_or_si256(vowels, _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('o')));
+		vowels = _mm256_or_si256(vowels, _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('u')));
+
+		uint32_t keep = ~(uint32_t)_mm256_movemask_epi8(vowels);
+
+		if (keep == UINT32_MAX) {
+			_mm256_storeu_si256((__m256i*)(out + j), chars);
+			j += 32;
+			continue;
+		}
+
+		// Compact every 8 bytes with a shuffle. Each store only overwrites
+		// input that was consumed already, so filtering in place is fine.
+		for (unsigned group = 0; group != 4; ++group) {
+			unsigned mask = (keep >> (8 * group)) & 0xFF;
+
+			__m128i bytes = _mm_loadl_epi64((const __m128i*)(in + i + 8 * group));
+			__m128i shuffle = _mm_cvtsi64_si128((long long)compressTable[mask]);
+			_mm_storel_epi64((__m128i*)(out + j), _mm_shuffle_epi8(bytes, shuffle));
+
+			j += __builtin_popcount(mask);
+		}
+	}
+
+	return j + filter_scalar(in + i, length - i, out + j);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi2"))) static size_t
+filter_avx512(const char* in, size_t length, char* out) {
+	const __m512i caseBit = _mm512_set1_epi8(0x20);
+	size_t i = 0, j = 0;
+
+	for (; i + 64 <= length; i += 64) {
+		__m512i chars = _mm512_loadu_si512((const void*)(in + i));
+		__m512i lower = _mm512_or_si512(chars, caseBit);
+
+		__mmask64 vowels = _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('a')) |
+		                   _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('e')) |
+		                   _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('i')) |
+		                   _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('o')) |
+		                   _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('u'));
+		__mmask64 keep = ~vowels;
+
+		// A full store followed by a short advance is faster than a
+		// compressing store on most CPUs.
+		_mm512_storeu_si512((void*)(out + j), _mm512_maskz_compress_epi8(keep, chars));
+		j += __builtin_popcountll(keep);
+	}
+
+	return j + filter_scalar(in + i, length - i, out + j);
+}
+
+#endif
+
+/** Returns the implementation if the CPU supports it. */
+static pfnVowelFilter get_filter(VowelFilterKind kind) {
+	switch (kind) {
+		case VOWEL_FILTER_SCALAR:
+			return filter_scalar;
+#ifdef VOWEL_FILTER_X86
+		case VOWEL_FILTER_SSE2:
+			return __builtin_cpu_supports("sse2") ? filter_sse2 : NULL;
+		case VOWEL_FILTER_AVX2:
+			return __builtin_cpu_supports("avx2") ? filter_avx2 : NULL;
+		case VOWEL_FILTER_AVX512:
+			return __builtin_cpu_supports("avx512bw") &&
+			               __builtin_cpu_supports("avx512vbmi2")
+			           ? filter_avx512
+			           : NULL;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+static pfnVowelFilter bestFilter = filter_scalar;
+
+static void init_filters(void) {
+#ifdef VOWEL_FILTER_X86
+	__builtin_cpu_init();
+	init_compress_table();
+#endif
+
+	for (int kind = VOWEL_FILTER_COUNT - 1; kind >= 0; --kind) {
+		pfnVowelFilter filter = get_filter((VowelFilterKind)kind);
+		if (filter) {
+			bestFilter = filter;
+			break;
+		}
+	}
+}
+
+size_t filter_vowels(const char* in, size_t length, char* out) {
+	pthread_once(&initOnce, init_filters);
+	return bestFilter(in, length, out);
+}
+
+pfnVowelFilter vowel_filter_get(VowelFilterKind kind) {
+	pthread_once(&initOnce, init_filters);
+	return get_filter(kind);
+}
+
+const char* vowel_filter_name(VowelFilterKind kind) {
+	switch (kind) {
+		case VOWEL_FILTER_SCALAR:
+			return "scalar";
+		case VOWEL_FILTER_SSE2:
+			return "sse2";
+		case VOWEL_FILTER_AVX2:
+			return "avx2";
+		case VOWEL_FILTER_AVX512:
+			return "avx512";
+		default:
+			return "unknown";
+	}
+}
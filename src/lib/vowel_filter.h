@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum VowelFilterKind {
+	VOWEL_FILTER_SCALAR,
+	VOWEL_FILTER_SSE2,
+	VOWEL_FILTER_AVX2,
+	VOWEL_FILTER_AVX512,
+	VOWEL_FILTER_COUNT,
+} VowelFilterKind;
+
+typedef size_t (*pfnVowelFilter)(const char* in, size_t length, char* out);
+
+/**
+ * Copies |length| chars from |in| to |out|, excluding vowels, and returns the
+ * amount of copied chars. |out| must have room for |length| chars; it may be
+ * the same as |in| to filter in place.
+ *
+ * Uses the fastest implementation that the CPU supports.
+ */
+size_t filter_vowels(const char* in, size_t length, char* out);
+
+/** Returns the given implementation, or NULL if the CPU doesn't support it. */
+pfnVowelFilter vowel_filter_get(VowelFilterKind kind);
+
+const char* vowel_filter_name(VowelFilterKind kind);
+
+#ifdef __cplusplus
+}
+#endif